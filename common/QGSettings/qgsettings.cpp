@@ -24,6 +24,10 @@
 
 #include <QDebug>
 #include <QString>
+#include <QTimer>
+
+/* 批量通知的静默时间(毫秒)，在此时间内没有新的 key 改变才发射 changedBatch */
+#define BATCH_QUIET_PERIOD  50
 
 struct QGSettingsPrivate
 {
@@ -32,6 +36,11 @@ struct QGSettingsPrivate
     QByteArray          schemaId;
     GSettings           *settings;
     gulong              signalHandlerId;
+    bool                coalesce;       /* 合并写入模式 */
+    bool                delayed;        /* 调用者显式调用了 delay() */
+    bool                flushPending;   /* 已安排在下一次主循环提交 */
+    QStringList         pendingKeys;    /* 等待通过 changedBatch 发送的 key */
+    QTimer              *batchTimer;
 
     static void settingChanged(GSettings *settings, const gchar *key, gpointer userData);
 };
@@ -49,7 +58,7 @@ void QGSettingsPrivate::settingChanged(GSettings *, const gchar *key, gpointer u
      * Qt::AutoConnection           则如果obj与调用者位于同一个线程中，则会同步调用该成员; 否则它将异步调用该成员
      *
      */
-    QMetaObject::invokeMethod(self, "changed", Qt::AutoConnection, Q_ARG(QString, key));
+    QMetaObject::invokeMethod(self, "onKeyChanged", Qt::AutoConnection, Q_ARG(QString, key));
 }
 
 
@@ -64,6 +73,34 @@ QGSettings::QGSettings(const QByteArray &schemaId, const QByteArray &path, QObje
     } else {
         mPriv->settings = g_settings_new_with_path(mPriv->schemaId.constData(), mPriv->path.constData());
     }
+    setup();
+}
+
+QGSettings::QGSettings(GSettings *settings, QObject *parent) : QObject(parent)
+{
+    gchar *schemaId = NULL, *path = NULL;
+
+    mPriv = new QGSettingsPrivate;
+    mPriv->settings = (GSettings *) g_object_ref(settings);
+
+    g_object_get(settings, "schema-id", &schemaId, "path", &path, NULL);
+    mPriv->schemaId = schemaId;
+    mPriv->path = path;
+    g_free(schemaId);
+    g_free(path);
+    setup();
+}
+
+void QGSettings::setup()
+{
+    mPriv->coalesce = false;
+    mPriv->delayed = false;
+    mPriv->flushPending = false;
+    mPriv->batchTimer = new QTimer(this);
+    mPriv->batchTimer->setSingleShot(true);
+    mPriv->batchTimer->setInterval(BATCH_QUIET_PERIOD);
+    connect(mPriv->batchTimer, SIGNAL(timeout()), this, SLOT(onBatchTimeout()));
+
     g_object_get(mPriv->settings, "settings-schema", &mPriv->schema, NULL);
     mPriv->signalHandlerId = g_signal_connect(mPriv->settings, "changed", G_CALLBACK(QGSettingsPrivate::settingChanged), this);
 }
@@ -71,6 +108,7 @@ QGSettings::QGSettings(const QByteArray &schemaId, const QByteArray &path, QObje
 QGSettings::~QGSettings()
 {
     if (mPriv->schema) {
+        flush();
         g_settings_sync ();
         g_signal_handler_disconnect(mPriv->settings, mPriv->signalHandlerId);
         g_object_unref (mPriv->settings);
@@ -105,8 +143,19 @@ bool QGSettings::trySet(const QString &key, const QVariant &value)
     GVariant *cur = g_settings_get_value(mPriv->settings, gkey);
 
     GVariant *new_value = qconf_types_collect_from_variant(g_variant_get_type (cur), value);
-    if (new_value)
-        success = g_settings_set_value(mPriv->settings, gkey, new_value);
+    if (new_value) {
+        if (mPriv->coalesce && g_variant_equal(cur, new_value)) {
+            /* 值未改变，不产生 dconf 写入 */
+            g_variant_unref(g_variant_ref_sink(new_value));
+            success = true;
+        } else {
+            success = g_settings_set_value(mPriv->settings, gkey, new_value);
+            if (success && mPriv->coalesce && !mPriv->delayed && !mPriv->flushPending) {
+                mPriv->flushPending = true;
+                QTimer::singleShot(0, this, SLOT(onFlushTimeout()));
+            }
+        }
+    }
 
     g_free(gkey);
     g_variant_unref (cur);
@@ -116,7 +165,15 @@ bool QGSettings::trySet(const QString &key, const QVariant &value)
 
 void QGSettings::setEnum(const QString& key,int value)
 {
+    if (mPriv->coalesce && g_settings_get_enum(mPriv->settings, key.toLatin1().data()) == value)
+        return;
+
     g_settings_set_enum (mPriv->settings,key.toLatin1().data(),value);
+
+    if (mPriv->coalesce && !mPriv->delayed && !mPriv->flushPending) {
+        mPriv->flushPending = true;
+        QTimer::singleShot(0, this, SLOT(onFlushTimeout()));
+    }
 }
 
 int QGSettings::getEnum(const QString& key)
@@ -133,14 +190,65 @@ char **QGSettings::getStrv(const QString& key)
 
 void QGSettings::delay()
 {
+    mPriv->delayed = true;
     g_settings_delay(mPriv->settings);
 }
 
 void QGSettings::apply()
 {
+    mPriv->delayed = false;
+    mPriv->flushPending = false;
     g_settings_apply(mPriv->settings);
 }
 
+void QGSettings::coalesce()
+{
+    if (mPriv->coalesce)
+        return;
+
+    mPriv->coalesce = true;
+    g_settings_delay(mPriv->settings);
+}
+
+void QGSettings::flush()
+{
+    mPriv->flushPending = false;
+    if (!mPriv->coalesce || mPriv->delayed)
+        return;
+
+    /* 延迟后端会把所有待写入的 key 作为一个变更集提交给 dconf */
+    if (g_settings_get_has_unapplied(mPriv->settings))
+        g_settings_apply(mPriv->settings);
+}
+
+void QGSettings::onFlushTimeout()
+{
+    if (mPriv->flushPending)
+        flush();
+}
+
+void QGSettings::onKeyChanged(const QString &key)
+{
+    Q_EMIT changed(key);
+
+    /* 没有连接 changedBatch 时不做合并 */
+    if (receivers(SIGNAL(changedBatch(QStringList))) <= 0)
+        return;
+
+    if (!mPriv->pendingKeys.contains(key))
+        mPriv->pendingKeys.append(key);
+    mPriv->batchTimer->start();
+}
+
+void QGSettings::onBatchTimeout()
+{
+    QStringList keys = mPriv->pendingKeys;
+
+    mPriv->pendingKeys.clear();
+    if (!keys.isEmpty())
+        Q_EMIT changedBatch(keys);
+}
+
 QStringList QGSettings::keys() const
 {
     QStringList list;
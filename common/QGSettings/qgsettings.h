@@ -22,6 +22,8 @@
 #include <QObject>
 #include <QStringList>
 
+typedef struct _GSettings GSettings;
+
 /**
  * gsettings 的 key 必须是小写字符和下划线组成
  * 此类将所有key转为驼峰方式
@@ -33,6 +35,9 @@ class QGSettings : public QObject
 public:
     /* 根据 schemaId 和 path 创建QGSettings对象 */
     explicit QGSettings(const QByteArray& schemaId, const QByteArray& path=QByteArray(), QObject *parent = nullptr);
+
+    /* 包装已有的 GSettings 对象，增加一个引用，析构时释放 */
+    explicit QGSettings(GSettings *settings, QObject *parent = nullptr);
     ~QGSettings();
 
     /**
@@ -60,6 +65,21 @@ public:
      */
     void apply();
 
+    /**
+     * 将QGSettings对象切换为'合并写入'模式。
+     * 在此模式下，与当前值相同的写入会被直接丢弃，
+     * 同一次主循环内的多次写入会被合并，
+     * 并在下一次主循环时通过一个 dconf 事务统一写入后端。
+     * 适用于按键、传感器等高频写入的场景。
+     */
+    void coalesce();
+
+    /**
+     * 立即写入'合并写入'模式下尚未提交的更改。
+     * 如果没有待提交的更改或处于'延迟-应用'模式，则什么都不做。
+     */
+    void flush();
+
     /**
      * @brief setEnum
      * @param key
@@ -119,7 +139,21 @@ Q_SIGNALS:
      */
     void changed (const QString& key);
 
+    /**
+     * 一组 key 的值改变时发射信号
+     * 短时间内连续改变的多个 key 合并为一次发射(例如控制面板恢复默认设置)，
+     * 需要整体重新应用设置的模块应连接此信号而不是 changed()
+     */
+    void changedBatch (const QStringList& keys);
+
+private Q_SLOTS:
+    void onFlushTimeout();
+    void onKeyChanged(const QString& key);
+    void onBatchTimeout();
+
 private:
+    void setup();
+
     struct QGSettingsPrivate* mPriv;
     friend struct QGSettingsPrivate;
 
@@ -6,7 +6,7 @@ INCLUDEPATH += -I $$PWD/
 
 PLUGIN_INSTALL_DIRS = $$[QT_INSTALL_LIBS]/ukui-settings-daemon
 
-PKGCONFIG += glib-2.0  gio-2.0 libxklavier x11 xrandr xtst atk gdk-3.0 gtk+-3.0 xi
+PKGCONFIG += glib-2.0  gio-2.0 libxklavier x11 x11-xcb xcb xrandr xtst atk gdk-3.0 gtk+-3.0 xi
 
 SOURCES += \
         $$PWD/clib-syslog.c             \
@@ -15,7 +15,11 @@ SOURCES += \
         $$PWD/xeventmonitor.cpp         \
         $$PWD/eggaccelerators.c         \
         $$PWD/ukui-input-helper.c       \
-        $$PWD/ukui-keygrab.cpp
+        $$PWD/ukui-keygrab.cpp          \
+        $$PWD/ukui-settings-pool.cpp    \
+        $$PWD/ukui-shortcut-registry.cpp \
+        $$PWD/ukui-prefork-launcher.cpp \
+        $$PWD/ukui-display-coordinator.cpp
 
 HEADERS += \
         $$PWD/clib-syslog.h             \
@@ -26,4 +30,8 @@ HEADERS += \
         $$PWD/eggaccelerators.h         \
         $$PWD/ukui-input-helper.h       \
         $$PWD/ukui-keygrab.h            \
+        $$PWD/ukui-settings-pool.h      \
+        $$PWD/ukui-shortcut-registry.h  \
+        $$PWD/ukui-prefork-launcher.h   \
+        $$PWD/ukui-display-coordinator.h \
         $$PWD/config.h
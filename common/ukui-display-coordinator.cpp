@@ -0,0 +1,146 @@
+/* -*- Mode: C++; indent-tabs-mode: nil; tab-width: 4 -*-
+ * -*- coding: utf-8 -*-
+ *
+ * Copyright (C) 2020 KylinSoft Co., Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "ukui-display-coordinator.h"
+
+#include <QDebug>
+#include <QTimer>
+
+/* 一次插拔产生的事件通常在这段时间内结束 */
+#define DISPLAY_SETTLE_TIMEOUT      300
+/* 阶段反复改变配置时最多重新执行的次数，避免循环 */
+#define DISPLAY_MAX_RESTARTS        3
+
+DisplayCoordinator *DisplayCoordinator::mCoordinator = nullptr;
+
+DisplayCoordinator::DisplayCoordinator()
+{
+    mSettleTimer = new QTimer(this);
+    mSettleTimer->setSingleShot(true);
+    mSettleTimer->setInterval(DISPLAY_SETTLE_TIMEOUT);
+    connect(mSettleTimer, SIGNAL(timeout()), this, SLOT(runPipeline()));
+    mRestarts = 0;
+    mRunning = false;
+}
+
+DisplayCoordinator::~DisplayCoordinator()
+{
+}
+
+bool DisplayCoordinator::hasStage(DisplayStage stage, DisplayStageFunc func, gpointer userData)
+{
+    Q_FOREACH (const Entry &entry, mStages[stage]) {
+        if (entry.func == func && entry.userData == userData)
+            return true;
+    }
+    return false;
+}
+
+bool DisplayCoordinator::isEmpty()
+{
+    for (int i = 0; i < DISPLAY_N_STAGES; i++) {
+        if (!mStages[i].isEmpty())
+            return false;
+    }
+    return true;
+}
+
+void DisplayCoordinator::addStage(DisplayStage stage, DisplayStageFunc func, gpointer userData)
+{
+    Entry entry;
+
+    if (stage < 0 || stage >= DISPLAY_N_STAGES || !func)
+        return;
+
+    if (nullptr == mCoordinator)
+        mCoordinator = new DisplayCoordinator();
+    if (mCoordinator->hasStage(stage, func, userData))
+        return;
+
+    entry.func = func;
+    entry.userData = userData;
+    mCoordinator->mStages[stage].append(entry);
+}
+
+void DisplayCoordinator::removeStage(DisplayStage stage, DisplayStageFunc func, gpointer userData)
+{
+    DisplayCoordinator *coordinator = mCoordinator;
+
+    if (!coordinator || stage < 0 || stage >= DISPLAY_N_STAGES)
+        return;
+
+    for (int i = 0; i < coordinator->mStages[stage].size(); i++) {
+        const Entry &entry = coordinator->mStages[stage].at(i);
+        if (entry.func == func && entry.userData == userData) {
+            coordinator->mStages[stage].removeAt(i);
+            break;
+        }
+    }
+
+    /* 执行中的阶段移除自己时，由 runPipeline() 结束后销毁 */
+    if (coordinator->isEmpty() && !coordinator->mRunning) {
+        delete coordinator;
+        mCoordinator = nullptr;
+    }
+}
+
+void DisplayCoordinator::queueChange()
+{
+    if (!mCoordinator)
+        return;
+    /* 每次变化都重新计时，只处理平息后的最终状态 */
+    mCoordinator->mSettleTimer->start();
+}
+
+void DisplayCoordinator::runPipeline()
+{
+    bool restart = false;
+    int  stage;
+
+    mRunning = true;
+    for (stage = 0; stage < DISPLAY_N_STAGES && !restart; stage++) {
+        /* 阶段中可能注册或移除其他阶段，遍历副本并确认仍然存在 */
+        QList<Entry> entries = mStages[stage];
+
+        Q_FOREACH (const Entry &entry, entries) {
+            if (!hasStage((DisplayStage) stage, entry.func, entry.userData))
+                continue;
+            if (!entry.func(entry.userData))
+                continue;
+            if (mRestarts < DISPLAY_MAX_RESTARTS)
+                restart = true;
+            else
+                qWarning("display configuration keeps changing, continuing with the current state");
+        }
+    }
+    mRunning = false;
+
+    if (isEmpty()) {
+        mCoordinator = nullptr;
+        deleteLater();
+        return;
+    }
+
+    if (restart) {
+        /* 配置刚被改变，等新配置的事件平息后再从头执行 */
+        mRestarts++;
+        mSettleTimer->start();
+    } else {
+        mRestarts = 0;
+    }
+}
@@ -0,0 +1,92 @@
+/* -*- Mode: C++; indent-tabs-mode: nil; tab-width: 4 -*-
+ * -*- coding: utf-8 -*-
+ *
+ * Copyright (C) 2020 KylinSoft Co., Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef UKUIDISPLAYCOORDINATOR_H
+#define UKUIDISPLAYCOORDINATOR_H
+
+#include <QObject>
+#include <QList>
+
+#include <glib.h>
+
+class QTimer;
+
+/* 显示配置变化后各阶段的执行顺序 */
+typedef enum {
+    DISPLAY_STAGE_LAYOUT,       /* 输出布局 */
+    DISPLAY_STAGE_GAMMA,        /* 各输出的 gamma 曲线 */
+    DISPLAY_STAGE_XSETTINGS,    /* DPI 和 XSETTINGS */
+    DISPLAY_STAGE_WALLPAPER,    /* 桌面背景 */
+    DISPLAY_N_STAGES
+} DisplayStage;
+
+/**
+ * 显示配置变化后执行的阶段。
+ * 返回 true 表示该阶段又改变了显示配置（例如应用了新布局），
+ * 本轮不再继续，等新配置产生的事件平息后从头重新执行
+ */
+typedef bool (*DisplayStageFunc) (gpointer user_data);
+
+/**
+ * 显示配置变化的协调者
+ * 一次插拔会产生一连串 RandR 事件和 Qt 的屏幕信号，各插件收到后
+ * 只调用 queueChange()。事件平息后按 布局 -> gamma -> DPI/XSETTINGS -> 背景
+ * 的顺序对最终状态执行一次各插件注册的阶段，跳过中间状态。
+ *
+ * 插件以 QLibrary::ExportExternalSymbolsHint 加载，
+ * 因此所有插件使用的是同一个协调者。
+ */
+class DisplayCoordinator : public QObject
+{
+    Q_OBJECT
+
+public:
+    static void addStage(DisplayStage stage, DisplayStageFunc func, gpointer userData);
+    /* 最后一个阶段移除时协调者随之销毁 */
+    static void removeStage(DisplayStage stage, DisplayStageFunc func, gpointer userData);
+
+    /* 显示配置可能已经改变，合并一段时间内的多次调用 */
+    static void queueChange();
+
+private Q_SLOTS:
+    void runPipeline();
+
+private:
+    DisplayCoordinator();
+    ~DisplayCoordinator();
+    DisplayCoordinator(const DisplayCoordinator&) = delete;
+    DisplayCoordinator& operator= (const DisplayCoordinator&) = delete;
+
+    bool hasStage(DisplayStage stage, DisplayStageFunc func, gpointer userData);
+    bool isEmpty();
+
+private:
+    struct Entry {
+        DisplayStageFunc func;
+        gpointer         userData;
+    };
+
+    static DisplayCoordinator *mCoordinator;
+
+    QList<Entry>     mStages[DISPLAY_N_STAGES];
+    QTimer          *mSettleTimer;
+    int              mRestarts;     /* 布局阶段连续要求重新执行的次数 */
+    bool             mRunning;
+};
+
+#endif // UKUIDISPLAYCOORDINATOR_H
@@ -26,6 +26,10 @@
 #include <gdk/gdkx.h>
 #endif
 
+#include <stdlib.h>
+#include <X11/Xlib-xcb.h>
+#include <xcb/xcb.h>
+
 #include "eggaccelerators.h"
 
 /* these are the mods whose combinations are ignored by the keygrabbing code */
@@ -113,10 +117,11 @@ grab_key_real (guint      keycode,
  * operations with one flush only.
  */
 #define N_BITS 32
-void
-grab_key_unsafe (Key                 *key,
-                 bool             grab,
-                 QList<GdkScreen*>   *screens)
+
+/* Fill @masks with every combination of the ignored modifiers not used
+ * by @key, each or'ed with the modifiers of @key */
+static void
+key_grab_masks (Key *key, GArray *masks)
 {
         int   indexes[N_BITS]; /* indexes of bits we need to flip */
         int   i;
@@ -140,11 +145,9 @@ grab_key_unsafe (Key                 *key,
         bits_set_cnt = bit;
 
         uppervalue = 1 << bits_set_cnt;
-        /* grab all possible modifier combinations for our mask */
         for (i = 0; i < uppervalue; ++i) {
-                QList<GdkScreen*>::iterator l,begin,end;
                 int     j;
-                int     result = 0;
+                guint   result = 0;
 
                 /* map bits in the counter to those in the mask */
                 for (j = 0; j < bits_set_cnt; ++j) {
@@ -153,6 +156,25 @@ grab_key_unsafe (Key                 *key,
                         }
                 }
 
+                result |= key->state;
+                g_array_append_val (masks, result);
+        }
+}
+
+void
+grab_key_unsafe (Key                 *key,
+                 bool             grab,
+                 QList<GdkScreen*>   *screens)
+{
+        GArray *masks = g_array_new (FALSE, FALSE, sizeof (guint));
+        guint   i;
+
+        key_grab_masks (key, masks);
+
+        /* grab all possible modifier combinations for our mask */
+        for (i = 0; i < masks->len; ++i) {
+                QList<GdkScreen*>::iterator l,begin,end;
+
                 l = begin = screens->begin();
                 end = screens->end();
                 for (; l != end; ++l) {
@@ -163,10 +185,140 @@ grab_key_unsafe (Key                 *key,
                                 grab_key_real (*code,
                                                window,
                                                grab,
-                                               result | key->state);
+                                               g_array_index (masks, guint, i));
                         }
                 }
         }
+
+        g_array_free (masks, TRUE);
+}
+
+typedef struct {
+        Key      *key;
+        gpointer  data;
+        gboolean  failed;
+} KeyGrabSlot;
+
+typedef struct {
+        xcb_void_cookie_t cookie;
+        guint             slot;
+} KeyGrabRequest;
+
+struct _KeyGrabBatch {
+        xcb_connection_t *conn;
+        GArray           *roots;        /* xcb_window_t */
+        GArray           *slots;        /* KeyGrabSlot, grabs only */
+        GArray           *requests;     /* KeyGrabRequest */
+};
+
+KeyGrabBatch *
+grab_key_batch_new (QList<GdkScreen*> *screens)
+{
+        KeyGrabBatch *batch = g_new0 (KeyGrabBatch, 1);
+        QList<GdkScreen*>::iterator l;
+
+        batch->conn = XGetXCBConnection (GDK_DISPLAY_XDISPLAY (gdk_display_get_default ()));
+        batch->roots = g_array_new (FALSE, FALSE, sizeof (xcb_window_t));
+        batch->slots = g_array_new (FALSE, FALSE, sizeof (KeyGrabSlot));
+        batch->requests = g_array_new (FALSE, FALSE, sizeof (KeyGrabRequest));
+
+        for (l = screens->begin (); l != screens->end (); ++l) {
+                xcb_window_t root = GDK_WINDOW_XID (gdk_screen_get_root_window (*l));
+                g_array_append_val (batch->roots, root);
+        }
+
+        return batch;
+}
+
+void
+grab_key_batch_add (KeyGrabBatch *batch,
+                    Key          *key,
+                    bool          grab,
+                    gpointer      data)
+{
+        GArray *masks;
+        guint   slot = G_MAXUINT;
+        guint   i, r;
+        guint  *code;
+
+        if (key == NULL || key->keycodes == NULL)
+                return;
+
+        if (grab) {
+                KeyGrabSlot new_slot = { key, data, FALSE };
+
+                slot = batch->slots->len;
+                g_array_append_val (batch->slots, new_slot);
+        }
+
+        masks = g_array_new (FALSE, FALSE, sizeof (guint));
+        key_grab_masks (key, masks);
+
+        for (i = 0; i < masks->len; ++i) {
+                uint16_t modifiers = g_array_index (masks, guint, i);
+
+                for (r = 0; r < batch->roots->len; ++r) {
+                        xcb_window_t root = g_array_index (batch->roots, xcb_window_t, r);
+
+                        for (code = key->keycodes; *code; ++code) {
+                                KeyGrabRequest request;
+
+                                if (grab)
+                                        request.cookie = xcb_grab_key_checked (batch->conn, TRUE, root,
+                                                                               modifiers, *code,
+                                                                               XCB_GRAB_MODE_ASYNC,
+                                                                               XCB_GRAB_MODE_ASYNC);
+                                else
+                                        request.cookie = xcb_ungrab_key_checked (batch->conn, *code,
+                                                                                 root, modifiers);
+                                request.slot = slot;
+                                g_array_append_val (batch->requests, request);
+                        }
+                }
+        }
+
+        g_array_free (masks, TRUE);
+}
+
+guint
+grab_key_batch_finish (KeyGrabBatch      *batch,
+                       KeyGrabFailedFunc  failed,
+                       gpointer           user_data)
+{
+        guint n_failed = 0;
+        guint i;
+
+        /* The first check waits for the whole burst, the others only
+         * collect errors that have already arrived */
+        for (i = 0; i < batch->requests->len; ++i) {
+                KeyGrabRequest      *request = &g_array_index (batch->requests, KeyGrabRequest, i);
+                xcb_generic_error_t *error = xcb_request_check (batch->conn, request->cookie);
+
+                if (error == NULL)
+                        continue;
+
+                if (request->slot != G_MAXUINT)
+                        g_array_index (batch->slots, KeyGrabSlot, request->slot).failed = TRUE;
+                free (error);
+        }
+
+        for (i = 0; i < batch->slots->len; ++i) {
+                KeyGrabSlot *slot = &g_array_index (batch->slots, KeyGrabSlot, i);
+
+                if (!slot->failed)
+                        continue;
+
+                n_failed++;
+                if (failed)
+                        failed (slot->key, slot->data, user_data);
+        }
+
+        g_array_free (batch->roots, TRUE);
+        g_array_free (batch->slots, TRUE);
+        g_array_free (batch->requests, TRUE);
+        g_free (batch);
+
+        return n_failed;
 }
 
 static gboolean
@@ -249,3 +401,150 @@ match_key (Key *key, XEvent *event)
                 && key->state == (event->xkey.state & usd_used_mods)
                 && key_uses_keycode (key, event->xkey.keycode));
 }
+
+typedef struct {
+        Key      *key;
+        gpointer  data;
+} KeyIndexEntry;
+
+struct _KeyIndex {
+        GHashTable *table;      /* (keycode, state) -> GSList of KeyIndexEntry */
+};
+
+static inline gint64
+key_index_hash_key (guint keycode, guint state)
+{
+        return ((gint64) keycode << 32) | state;
+}
+
+static void
+key_index_entries_free (gpointer entries)
+{
+        g_slist_free_full ((GSList *) entries, g_free);
+}
+
+KeyIndex *
+key_index_new (void)
+{
+        KeyIndex *index = g_new0 (KeyIndex, 1);
+
+        index->table = g_hash_table_new_full (g_int64_hash, g_int64_equal,
+                                              g_free, key_index_entries_free);
+        return index;
+}
+
+void
+key_index_free (KeyIndex *index)
+{
+        if (index == NULL)
+                return;
+
+        g_hash_table_destroy (index->table);
+        g_free (index);
+}
+
+void
+key_index_clear (KeyIndex *index)
+{
+        g_hash_table_remove_all (index->table);
+}
+
+void
+key_index_add (KeyIndex *index, Key *key, gpointer data)
+{
+        guint *code;
+
+        if (key == NULL || key->keycodes == NULL)
+                return;
+
+        for (code = key->keycodes; *code; ++code) {
+                gint64         hash_key = key_index_hash_key (*code, key->state);
+                GSList        *entries;
+                KeyIndexEntry *entry;
+
+                entry = g_new0 (KeyIndexEntry, 1);
+                entry->key = key;
+                entry->data = data;
+
+                /* keep insertion order, the first added key wins like a
+                 * linear scan over the bindings would */
+                entries = (GSList *) g_hash_table_lookup (index->table, &hash_key);
+                if (entries != NULL) {
+                        entries = g_slist_append (entries, entry);
+                } else {
+                        gint64 *new_key = g_new (gint64, 1);
+
+                        *new_key = hash_key;
+                        g_hash_table_insert (index->table, new_key,
+                                             g_slist_append (NULL, entry));
+                }
+        }
+}
+
+static gboolean
+key_index_find (KeyIndex *index,
+                guint     keycode,
+                guint     state,
+                guint     keysym,
+                gboolean  any_keysym,
+                gpointer *data)
+{
+        gint64  hash_key = key_index_hash_key (keycode, state);
+        GSList *l;
+
+        for (l = (GSList *) g_hash_table_lookup (index->table, &hash_key); l; l = l->next) {
+                KeyIndexEntry *entry = (KeyIndexEntry *) l->data;
+
+                if (any_keysym || entry->key->keysym == keysym) {
+                        if (data)
+                                *data = entry->data;
+                        return TRUE;
+                }
+        }
+        return FALSE;
+}
+
+gboolean
+key_index_lookup (KeyIndex *index, XEvent *event, gpointer *data)
+{
+        guint keyval;
+        GdkModifierType consumed;
+        gint group;
+        guint keycode = event->xkey.keycode;
+        guint state = event->xkey.state;
+
+        if (index == NULL)
+                return FALSE;
+
+        setup_modifiers ();
+
+#ifdef HAVE_X11_EXTENSIONS_XKB_H
+        if (have_xkb (event->xkey.display))
+                group = XkbGroupForCoreState (state);
+        else
+#endif
+                group = (state & GDK_KEY_Mode_switch) ? 1 : 0;
+
+        if (gdk_keymap_translate_keyboard_state (gdk_keymap_get_for_display (gdk_display_get_default ()),
+                                                 keycode, (GdkModifierType) state, group,
+                                                 &keyval, NULL, NULL, &consumed)) {
+                guint lower, upper;
+
+                gdk_keyval_convert_case (keyval, &lower, &upper);
+
+                /* Same rules as match_key(): when matching the lower version
+                 * of the keysym, Shift is not treated as consumed */
+                if (key_index_find (index, keycode,
+                                    state & ~(consumed & ~GDK_SHIFT_MASK) & usd_used_mods,
+                                    lower, FALSE, data))
+                        return TRUE;
+
+                return upper != lower
+                        && key_index_find (index, keycode,
+                                           state & ~consumed & usd_used_mods,
+                                           upper, FALSE, data);
+        }
+
+        /* The key doesn't have a keysym, so try with just the keycode */
+        return key_index_find (index, keycode, state & usd_used_mods, 0, TRUE, data);
+}
@@ -47,9 +47,44 @@ void	        grab_key_unsafe	(Key     *key,
 gboolean        match_key       (Key     *key,
                                  XEvent  *event);
 
+/* Pipelined key grabbing over XCB.  Every grab and ungrab added to a
+ * batch is sent immediately as a checked request, no error trap is
+ * needed.  grab_key_batch_finish() waits once for all of them, reports
+ * each key whose grab failed through @failed and frees the batch.
+ * The batch does not keep ungrabbed keys, they may be freed right after
+ * grab_key_batch_add(). */
+typedef struct _KeyGrabBatch KeyGrabBatch;
+typedef void (*KeyGrabFailedFunc) (Key *key, gpointer data, gpointer user_data);
+
+KeyGrabBatch *  grab_key_batch_new    (QList<GdkScreen*>  *screens);
+void            grab_key_batch_add    (KeyGrabBatch       *batch,
+                                       Key                *key,
+                                       bool                grab,
+                                       gpointer            data);
+guint           grab_key_batch_finish (KeyGrabBatch       *batch,
+                                       KeyGrabFailedFunc   failed,
+                                       gpointer            user_data);
+
 gboolean        key_uses_keycode (const Key *key,
                                   guint keycode);
 
+/* Dispatch index of grabbed keys, keyed on (keycode, used modifiers).
+ * A lookup does one keymap translation and at most two hash lookups,
+ * matching the same keys match_key() would.  The index stores the
+ * keycodes resolved when the keys were added, so it must be rebuilt
+ * whenever the bindings are re-parsed or the keymap changes. */
+typedef struct _KeyIndex KeyIndex;
+
+KeyIndex *      key_index_new    (void);
+void            key_index_free   (KeyIndex *index);
+void            key_index_clear  (KeyIndex *index);
+void            key_index_add    (KeyIndex *index,
+                                  Key      *key,
+                                  gpointer  data);
+gboolean        key_index_lookup (KeyIndex *index,
+                                  XEvent   *event,
+                                  gpointer *data);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,503 @@
+/* -*- Mode: C++; indent-tabs-mode: nil; tab-width: 4 -*-
+ * -*- coding: utf-8 -*-
+ *
+ * Copyright (C) 2020 KylinSoft Co., Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "ukui-prefork-launcher.h"
+#include "ukui-settings-pool.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <string.h>
+#include <syslog.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <glib-unix.h>
+#include <gio/gio.h>
+
+#define PREFORK_MESSAGE_MAX     4096
+#define PREFORK_ARGS_MAX        64
+
+typedef struct {
+    gchar   *name;          /* 设置中列出的程序名 */
+    gchar   *path;          /* 预先解析的完整路径 */
+    GPid     pid;           /* 等待中的子进程，0 表示没有 */
+    int      cmd_fd;        /* 写入启动参数 */
+    int      status_fd;     /* exec 成功时读到 EOF，失败时读到 errno */
+    guint    refill_id;
+
+    guint    launches;
+    guint    warm_launches;
+    gint64   total_us;
+    gint64   max_us;
+} PreforkTarget;
+
+typedef struct {
+    gchar           *name;          /* 目标可能在启动完成前被重新加载，按名字查找 */
+    gint64           start;
+    int              status_fd;
+    gchar           *working_dir;
+    gchar          **argv;
+} PreforkLaunch;
+
+/* spawn() 也会在插件的启动线程中调用，其余入口在主循环中 */
+static GMutex       launcher_lock;
+static int          launcher_refs = 0;
+static GSettings   *launcher_settings = NULL;
+static GPtrArray   *launcher_targets = NULL;   /* PreforkTarget */
+static GHashTable  *launcher_stats = NULL;     /* 未预创建的程序 -> PreforkTarget，只用于统计 */
+
+static ssize_t
+read_full (int fd, void *buf, size_t len)
+{
+    size_t done = 0;
+
+    while (done < len) {
+        ssize_t n = read (fd, (char *) buf + done, len - done);
+
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return done;
+        done += n;
+    }
+    return done;
+}
+
+/* fork 之后到 exec 之前只能调用异步信号安全的函数，
+ * 所需的内存都在父进程中准备好 */
+static void G_GNUC_NORETURN
+prefork_child_run (const char *path, char **envp, int cmd_fd, int status_fd,
+                   int max_fd, char *buf, char **argv)
+{
+    struct sigaction action;
+    sigset_t         mask;
+    guint32          len;
+    char            *p, *end, *working_dir;
+    int              fd, sig, argc, err;
+
+    sigemptyset (&mask);
+    sigprocmask (SIG_SETMASK, &mask, NULL);
+    memset (&action, 0, sizeof (action));
+    action.sa_handler = SIG_DFL;
+    for (sig = 1; sig < NSIG; sig++)
+        sigaction (sig, &action, NULL);
+
+    setsid ();
+    for (fd = 3; fd < max_fd; fd++) {
+        if (fd != cmd_fd && fd != status_fd)
+            close (fd);
+    }
+
+    /* 阻塞等待启动参数，管道关闭表示不再需要 */
+    if (read_full (cmd_fd, &len, sizeof (len)) != sizeof (len) || len >= PREFORK_MESSAGE_MAX)
+        _exit (0);
+    if (read_full (cmd_fd, buf, len) != (ssize_t) len)
+        _exit (0);
+    buf[len] = '\0';
+
+    working_dir = buf;
+    p = buf + strlen (buf) + 1;
+    end = buf + len;
+    for (argc = 0; p < end && argc < PREFORK_ARGS_MAX; argc++) {
+        argv[argc] = p;
+        p += strlen (p) + 1;
+    }
+    argv[argc] = NULL;
+
+    if (working_dir[0])
+        chdir (working_dir);
+    execve (path, argv, envp);
+
+    err = errno;
+    write (status_fd, &err, sizeof (err));
+    _exit (127);
+}
+
+static void
+prefork_child_exited (GPid pid, gint status, gpointer data)
+{
+    g_spawn_close_pid (pid);
+}
+
+static void
+prefork_target_fork (PreforkTarget *target)
+{
+    int     cmd_fds[2], status_fds[2];
+    int     max_fd = sysconf (_SC_OPEN_MAX);
+    char  **envp;
+    char   *buf;
+    char  **argv;
+    GPid    pid;
+
+    if (target->pid || !target->path)
+        return;
+
+    /* 命令通道用 socketpair，子进程意外退出时 send() 不会触发 SIGPIPE */
+    if (socketpair (AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, cmd_fds) < 0)
+        return;
+    if (!g_unix_open_pipe (status_fds, FD_CLOEXEC, NULL)) {
+        close (cmd_fds[0]);
+        close (cmd_fds[1]);
+        return;
+    }
+
+    envp = g_get_environ ();
+    buf = (char *) g_malloc (PREFORK_MESSAGE_MAX);
+    argv = g_new0 (char *, PREFORK_ARGS_MAX + 1);
+
+    pid = fork ();
+    if (pid == 0)
+        prefork_child_run (target->path, envp, cmd_fds[0], status_fds[1], max_fd, buf, argv);
+
+    g_strfreev (envp);
+    g_free (buf);
+    g_free (argv);
+    close (cmd_fds[0]);
+    close (status_fds[1]);
+
+    if (pid < 0) {
+        syslog (LOG_WARNING, "prefork: unable to fork for %s: %s", target->name, g_strerror (errno));
+        close (cmd_fds[1]);
+        close (status_fds[0]);
+        return;
+    }
+
+    target->pid = pid;
+    target->cmd_fd = cmd_fds[1];
+    target->status_fd = status_fds[0];
+    g_child_watch_add (pid, prefork_child_exited, NULL);
+}
+
+static void
+prefork_target_release (PreforkTarget *target)
+{
+    if (target->refill_id) {
+        g_source_remove (target->refill_id);
+        target->refill_id = 0;
+    }
+    if (target->pid) {
+        /* 关闭命令管道，等待中的子进程自行退出 */
+        close (target->cmd_fd);
+        close (target->status_fd);
+        target->pid = 0;
+    }
+}
+
+static void
+prefork_target_free (gpointer data)
+{
+    PreforkTarget *target = (PreforkTarget *) data;
+
+    prefork_target_release (target);
+    g_free (target->name);
+    g_free (target->path);
+    g_free (target);
+}
+
+static gboolean
+prefork_target_refill (gpointer data)
+{
+    PreforkTarget *target = (PreforkTarget *) data;
+
+    g_mutex_lock (&launcher_lock);
+    target->refill_id = 0;
+    prefork_target_fork (target);
+    g_mutex_unlock (&launcher_lock);
+    return G_SOURCE_REMOVE;
+}
+
+static void
+prefork_record (PreforkTarget *target, gint64 start, bool warm)
+{
+    gint64 elapsed = g_get_monotonic_time () - start;
+
+    target->launches++;
+    if (warm)
+        target->warm_launches++;
+    target->total_us += elapsed;
+    target->max_us = MAX (target->max_us, elapsed);
+
+    syslog (LOG_DEBUG, "prefork: %s started in %" G_GINT64_FORMAT " us (%s), "
+            "%u launches, %u warm, avg %" G_GINT64_FORMAT " us, max %" G_GINT64_FORMAT " us",
+            target->name, elapsed, warm ? "warm" : "cold",
+            target->launches, target->warm_launches,
+            target->total_us / target->launches, target->max_us);
+}
+
+static PreforkTarget *prefork_target_find (const char *name);
+
+static bool
+prefork_spawn_cold (PreforkTarget *target, const char *workingDir, char **argv, const char *path)
+{
+    gint64   start = g_get_monotonic_time ();
+    GError  *error = NULL;
+    gboolean retval;
+
+    if (path) {
+        /* 调用者已解析出可执行文件，跳过 PATH 查找，argv[0] 保持原样 */
+        GPtrArray *file_argv = g_ptr_array_new ();
+        char     **arg;
+
+        g_ptr_array_add (file_argv, (gpointer) path);
+        for (arg = argv; *arg; ++arg)
+            g_ptr_array_add (file_argv, *arg);
+        g_ptr_array_add (file_argv, NULL);
+        retval = g_spawn_async (workingDir, (char **) file_argv->pdata, NULL,
+                                G_SPAWN_FILE_AND_ARGV_ZERO, NULL, NULL, NULL, &error);
+        g_ptr_array_free (file_argv, TRUE);
+    } else
+        retval = g_spawn_async (workingDir, argv, NULL, G_SPAWN_SEARCH_PATH,
+                                NULL, NULL, NULL, &error);
+    if (!retval) {
+        syslog (LOG_WARNING, "prefork: unable to start %s: %s", argv[0], error->message);
+        g_error_free (error);
+        return false;
+    }
+
+    if (target)
+        prefork_record (target, start, false);
+    return true;
+}
+
+static void
+prefork_launch_free (PreforkLaunch *launch)
+{
+    close (launch->status_fd);
+    g_free (launch->name);
+    g_free (launch->working_dir);
+    g_strfreev (launch->argv);
+    g_free (launch);
+}
+
+static gboolean
+prefork_launch_done (gint fd, GIOCondition condition, gpointer data)
+{
+    PreforkLaunch *launch = (PreforkLaunch *) data;
+    PreforkTarget *target;
+    int            err = 0;
+
+    g_mutex_lock (&launcher_lock);
+    target = prefork_target_find (launch->name);
+
+    if (read_full (fd, &err, sizeof (err)) == sizeof (err)) {
+        syslog (LOG_WARNING, "prefork: exec of %s failed: %s", launch->argv[0], g_strerror (err));
+        prefork_spawn_cold (NULL, launch->working_dir, launch->argv, NULL);
+    } else if (target) {
+        prefork_record (target, launch->start, true);
+    }
+
+    g_mutex_unlock (&launcher_lock);
+
+    prefork_launch_free (launch);
+    return G_SOURCE_REMOVE;
+}
+
+static bool
+prefork_spawn_warm (PreforkTarget *target, const char *workingDir, char **argv)
+{
+    GString       *message = g_string_new (workingDir ? workingDir : "");
+    PreforkLaunch *launch;
+    guint32        len;
+    char         **arg;
+    bool           sent;
+
+    g_string_append_c (message, '\0');
+    for (arg = argv; *arg; ++arg)
+        g_string_append_len (message, *arg, strlen (*arg) + 1);
+    len = message->len;
+
+    sent = len < PREFORK_MESSAGE_MAX
+            && g_strv_length (argv) <= PREFORK_ARGS_MAX
+            && send (target->cmd_fd, &len, sizeof (len), MSG_NOSIGNAL) == sizeof (len)
+            && send (target->cmd_fd, message->str, len, MSG_NOSIGNAL) == (ssize_t) len;
+    g_string_free (message, TRUE);
+
+    if (!sent) {
+        /* 子进程已经退出，丢弃它并补充新的 */
+        prefork_target_release (target);
+        target->refill_id = g_idle_add (prefork_target_refill, target);
+        return false;
+    }
+
+    /* 子进程已被占用，状态管道交给这次启动，之后补充新的子进程 */
+    launch = g_new0 (PreforkLaunch, 1);
+    launch->name = g_strdup (target->name);
+    launch->start = g_get_monotonic_time ();
+    launch->status_fd = target->status_fd;
+    launch->working_dir = g_strdup (workingDir);
+    launch->argv = g_strdupv (argv);
+    g_unix_fd_add (launch->status_fd, (GIOCondition) (G_IO_IN | G_IO_HUP | G_IO_ERR),
+                   prefork_launch_done, launch);
+
+    close (target->cmd_fd);
+    target->pid = 0;
+    if (!target->refill_id)
+        target->refill_id = g_idle_add (prefork_target_refill, target);
+
+    return true;
+}
+
+static PreforkTarget *
+prefork_target_find (const char *name)
+{
+    guint i;
+
+    if (!launcher_targets)
+        return NULL;
+
+    for (i = 0; i < launcher_targets->len; ++i) {
+        PreforkTarget *target = (PreforkTarget *) g_ptr_array_index (launcher_targets, i);
+
+        if (g_strcmp0 (target->name, name) == 0 || g_strcmp0 (target->path, name) == 0)
+            return target;
+    }
+    return NULL;
+}
+
+/* 从旧列表中取出同名的目标，原位置留空 */
+static PreforkTarget *
+prefork_target_take (GPtrArray *targets, const char *name)
+{
+    guint i;
+
+    for (i = 0; i < targets->len; ++i) {
+        PreforkTarget *target = (PreforkTarget *) g_ptr_array_index (targets, i);
+
+        if (target && g_strcmp0 (target->name, name) == 0) {
+            g_ptr_array_index (targets, i) = NULL;
+            return target;
+        }
+    }
+    return NULL;
+}
+
+/* 仍在列表中的目标保留等待中的子进程，只为新增的目标 fork，释放移除的目标 */
+static void
+prefork_targets_reload (void)
+{
+    gchar    **names = g_settings_get_strv (launcher_settings, PREFORK_TARGETS_KEY);
+    gchar    **name;
+    GPtrArray *old_targets = launcher_targets;
+    guint      i;
+
+    launcher_targets = g_ptr_array_new_with_free_func (prefork_target_free);
+
+    for (name = names; *name; ++name) {
+        PreforkTarget *target;
+
+        if (prefork_target_find (*name))
+            continue;
+
+        target = prefork_target_take (old_targets, *name);
+        if (!target) {
+            target = g_new0 (PreforkTarget, 1);
+            target->name = g_strdup (*name);
+        }
+        if (!target->path) {
+            target->path = g_find_program_in_path (*name);
+            if (!target->path)
+                syslog (LOG_WARNING, "prefork: %s not found in PATH", *name);
+        }
+        /* 已有等待中的子进程时什么都不做 */
+        prefork_target_fork (target);
+        g_ptr_array_add (launcher_targets, target);
+    }
+    g_strfreev (names);
+
+    if (old_targets) {
+        g_ptr_array_set_free_func (old_targets, NULL);
+        for (i = 0; i < old_targets->len; ++i) {
+            PreforkTarget *target = (PreforkTarget *) g_ptr_array_index (old_targets, i);
+
+            if (target)
+                prefork_target_free (target);
+        }
+        g_ptr_array_free (old_targets, TRUE);
+    }
+}
+
+static void
+prefork_targets_changed (GSettings *settings, gchar *key, gpointer data)
+{
+    g_mutex_lock (&launcher_lock);
+    prefork_targets_reload ();
+    g_mutex_unlock (&launcher_lock);
+}
+
+void PreforkLauncher::ref()
+{
+    g_mutex_lock (&launcher_lock);
+    if (launcher_refs++ > 0) {
+        g_mutex_unlock (&launcher_lock);
+        return;
+    }
+
+    launcher_stats = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, prefork_target_free);
+    launcher_settings = SettingsPool::gsettingsRef (PREFORK_SCHEMA);
+    g_signal_connect (launcher_settings, "changed::" PREFORK_TARGETS_KEY,
+                      G_CALLBACK (prefork_targets_changed), NULL);
+    prefork_targets_reload ();
+    g_mutex_unlock (&launcher_lock);
+}
+
+void PreforkLauncher::unref()
+{
+    g_mutex_lock (&launcher_lock);
+    if (launcher_refs <= 0 || --launcher_refs > 0) {
+        g_mutex_unlock (&launcher_lock);
+        return;
+    }
+
+    g_signal_handlers_disconnect_by_func (launcher_settings, (gpointer) prefork_targets_changed, NULL);
+    g_clear_object (&launcher_settings);
+    g_ptr_array_free (launcher_targets, TRUE);
+    launcher_targets = NULL;
+    g_hash_table_destroy (launcher_stats);
+    launcher_stats = NULL;
+    g_mutex_unlock (&launcher_lock);
+}
+
+bool PreforkLauncher::spawn(const char *workingDir, char **argv, const char *path)
+{
+    PreforkTarget *target;
+    bool           retval;
+
+    if (!argv || !argv[0])
+        return false;
+
+    g_mutex_lock (&launcher_lock);
+    target = prefork_target_find (argv[0]);
+    if (target && target->pid && prefork_spawn_warm (target, workingDir, argv)) {
+        g_mutex_unlock (&launcher_lock);
+        return true;
+    }
+
+    /* 没有等待中的子进程，或者启动器未启用 */
+    if (!target && launcher_stats) {
+        target = (PreforkTarget *) g_hash_table_lookup (launcher_stats, argv[0]);
+        if (!target) {
+            target = g_new0 (PreforkTarget, 1);
+            target->name = g_strdup (argv[0]);
+            g_hash_table_insert (launcher_stats, target->name, target);
+        }
+    }
+    retval = prefork_spawn_cold (target, workingDir, argv, path);
+    g_mutex_unlock (&launcher_lock);
+
+    return retval;
+}
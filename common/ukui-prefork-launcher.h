@@ -0,0 +1,53 @@
+/* -*- Mode: C++; indent-tabs-mode: nil; tab-width: 4 -*-
+ * -*- coding: utf-8 -*-
+ *
+ * Copyright (C) 2020 KylinSoft Co., Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef UKUIPREFORKLAUNCHER_H
+#define UKUIPREFORKLAUNCHER_H
+
+#include <glib.h>
+
+/* 媒体键和自定义快捷键共用这一个列表 */
+#define PREFORK_SCHEMA          "org.ukui.SettingsDaemon.plugins.media-keys"
+#define PREFORK_TARGETS_KEY     "prefork-targets"
+
+/**
+ * 常用快捷键程序的预创建启动器
+ * 对设置中列出的程序，预先 fork 出已完成会话、信号和文件描述符
+ * 初始化的子进程，阻塞等待命令；按下快捷键时只需把参数写给子进程，
+ * 由它直接 exec，随后在空闲时补充新的子进程。
+ *
+ * 未列出的程序走普通的 g_spawn_async()。每次启动都会记录
+ * 从请求到 exec 完成的耗时及累计统计。
+ *
+ * 插件以 QLibrary::ExportExternalSymbolsHint 加载，
+ * 因此所有插件共用一个启动器。
+ */
+class PreforkLauncher
+{
+public:
+    static void ref();
+    static void unref();
+
+    /* argv[0] 为程序名，path 为空时在 PATH 中查找；返回 false 表示无法启动 */
+    static bool spawn(const char *workingDir, char **argv, const char *path = NULL);
+
+private:
+    PreforkLauncher() = delete;
+};
+
+#endif // UKUIPREFORKLAUNCHER_H
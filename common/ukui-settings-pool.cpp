@@ -0,0 +1,111 @@
+/* -*- Mode: C++; indent-tabs-mode: nil; tab-width: 4 -*-
+ * -*- coding: utf-8 -*-
+ *
+ * Copyright (C) 2020 KylinSoft Co., Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "ukui-settings-pool.h"
+#include "QGSettings/qgsettings.h"
+
+#include <QHash>
+
+struct SettingsPoolEntry
+{
+    QGSettings  *settings;
+    int          refCount;
+};
+
+static QHash<QByteArray, SettingsPoolEntry> qgsettingsPool;
+static GHashTable *gsettingsPool = NULL;
+
+static QByteArray pool_key (const QByteArray& schemaId, const QByteArray& path)
+{
+    return schemaId + ':' + path;
+}
+
+QGSettings *SettingsPool::ref(const QByteArray &schemaId, const QByteArray &path)
+{
+    QByteArray key = pool_key(schemaId, path);
+    QHash<QByteArray, SettingsPoolEntry>::iterator it = qgsettingsPool.find(key);
+
+    if (it != qgsettingsPool.end()) {
+        it->refCount++;
+        return it->settings;
+    }
+
+    /* 建立在共享的 GSettings 之上，与 gsettingsRef() 的使用者共用同一个对象 */
+    GSettings *settings = gsettingsRef(schemaId.constData(),
+                                       path.isEmpty() ? NULL : path.constData());
+    SettingsPoolEntry entry;
+    entry.settings = new QGSettings(settings);
+    entry.refCount = 1;
+    g_object_unref(settings);
+    qgsettingsPool.insert(key, entry);
+
+    return entry.settings;
+}
+
+void SettingsPool::unref(QGSettings *settings)
+{
+    QHash<QByteArray, SettingsPoolEntry>::iterator it;
+
+    if (!settings)
+        return;
+
+    for (it = qgsettingsPool.begin(); it != qgsettingsPool.end(); ++it) {
+        if (it->settings != settings)
+            continue;
+
+        if (--it->refCount <= 0) {
+            qgsettingsPool.erase(it);
+            delete settings;
+        }
+        return;
+    }
+
+    qWarning("QGSettings %p is not owned by the settings pool", settings);
+}
+
+static void gsettings_finalized (gpointer key, GObject *)
+{
+    g_hash_table_remove (gsettingsPool, key);
+}
+
+GSettings *SettingsPool::gsettingsRef(const char *schemaId, const char *path)
+{
+    GSettings *settings;
+    gchar     *key;
+
+    if (!gsettingsPool)
+        gsettingsPool = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+    key = g_strdup_printf ("%s:%s", schemaId, path ? path : "");
+    settings = (GSettings *) g_hash_table_lookup (gsettingsPool, key);
+    if (settings) {
+        g_free (key);
+        return (GSettings *) g_object_ref (settings);
+    }
+
+    if (path)
+        settings = g_settings_new_with_path (schemaId, path);
+    else
+        settings = g_settings_new (schemaId);
+
+    /* 池中只保存弱引用，最后一个使用者释放时自动移除 */
+    g_hash_table_insert (gsettingsPool, key, settings);
+    g_object_weak_ref (G_OBJECT (settings), (GWeakNotify) gsettings_finalized, key);
+
+    return settings;
+}
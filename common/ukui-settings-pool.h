@@ -0,0 +1,55 @@
+/* -*- Mode: C++; indent-tabs-mode: nil; tab-width: 4 -*-
+ * -*- coding: utf-8 -*-
+ *
+ * Copyright (C) 2020 KylinSoft Co., Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef UKUISETTINGSPOOL_H
+#define UKUISETTINGSPOOL_H
+
+#include <QByteArray>
+
+#include <gio/gio.h>
+
+class QGSettings;
+
+/**
+ * 进程内共享的 GSettings 对象池
+ * 同一 schema 和 path 只创建一个对象，避免每个插件各自持有
+ * schema 引用、信号连接和 dconf 监听。
+ * 共享的 QGSettings 包装的也是池中的 GSettings，因此无论通过哪个
+ * 接口获取，进程内每个 schema 和 path 只有一个 GSettings。
+ *
+ * 插件以 QLibrary::ExportExternalSymbolsHint 加载，
+ * 因此所有插件使用的是同一个对象池。
+ *
+ * 共享对象上不要调用 delay()/coalesce()（包括 g_settings_delay()），
+ * 否则会影响其他使用者。
+ */
+class SettingsPool
+{
+public:
+    /* 获取共享的 QGSettings 对象，不再使用时调用 unref()，不要 delete */
+    static QGSettings *ref(const QByteArray& schemaId, const QByteArray& path = QByteArray());
+    static void unref(QGSettings *settings);
+
+    /* 获取共享的 GSettings 对象，返回新的引用，不再使用时 g_object_unref() */
+    static GSettings *gsettingsRef(const char *schemaId, const char *path = NULL);
+
+private:
+    SettingsPool() = delete;
+};
+
+#endif // UKUISETTINGSPOOL_H
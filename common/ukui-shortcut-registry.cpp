@@ -0,0 +1,443 @@
+/* -*- Mode: C++; indent-tabs-mode: nil; tab-width: 4 -*-
+ * -*- coding: utf-8 -*-
+ *
+ * Copyright (C) 2020 KylinSoft Co., Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "ukui-shortcut-registry.h"
+
+#include <QDebug>
+#include <QStringList>
+#include <QDBusConnection>
+
+#include <string.h>
+#include <gdk/gdkx.h>
+
+extern "C" {
+#include "eggaccelerators.h"
+}
+
+struct _ShortcutClient
+{
+    char                 *owner;
+    ShortcutActivateFunc  activate;
+    ShortcutFailedFunc    failed;
+    gpointer              user_data;
+};
+
+struct ShortcutEntry
+{
+    ShortcutClient  *client;
+    char            *accel;
+    Key              key;           /* 注册时复制的按键 */
+    gpointer         data;
+    bool             active;        /* 持有抓取并参与分发 */
+    bool             failed;        /* 抓取被其他 X 客户端拒绝 */
+};
+
+ShortcutRegistry *ShortcutRegistry::mRegistry = nullptr;
+
+static inline gint64
+claim_key (guint keycode, guint state)
+{
+    return ((gint64) keycode << 32) | state;
+}
+
+static void
+shortcut_entry_free (gpointer data)
+{
+    ShortcutEntry *entry = (ShortcutEntry *) data;
+
+    g_free (entry->accel);
+    g_free (entry->key.keycodes);
+    g_free (entry);
+}
+
+/* 同一组合键的不同写法（如 <Ctrl> 与 <Control>）归一化后比较 */
+static QString
+normalized_accel (const Key *key)
+{
+    gchar   *name = egg_virtual_accelerator_name (key->keysym, 0,
+                                                  (EggVirtualModifierType) key->state);
+    QString  result = QString::fromUtf8 (name);
+
+    g_free (name);
+    return result;
+}
+
+ShortcutRegistry::ShortcutRegistry()
+{
+    GdkDisplay  *display = gdk_display_get_default ();
+    GdkScreen   *screen = gdk_display_get_default_screen (display);
+    GdkWindow   *root = gdk_screen_get_root_window (screen);
+    Display     *xdpy = GDK_DISPLAY_XDISPLAY (display);
+    XWindowAttributes atts;
+
+    mClients = NULL;
+    mEntries = NULL;
+    mDead = NULL;
+    mClaims = g_hash_table_new_full (g_int64_hash, g_int64_equal, g_free, NULL);
+    mIndex = key_index_new ();
+    mBatch = NULL;
+    mChanged = false;
+    mScreens.append (screen);
+
+    /* 所有插件共用一个根窗口过滤器 */
+    gdk_window_add_filter (root, filter, this);
+
+    gdk_x11_display_error_trap_push (display);
+    XGetWindowAttributes (xdpy, GDK_WINDOW_XID (root), &atts);
+    XSelectInput (xdpy, GDK_WINDOW_XID (root), atts.your_event_mask | KeyPressMask);
+    gdk_x11_display_error_trap_pop_ignored (display);
+
+    QDBusConnection::sessionBus ().registerObject (SHORTCUT_REGISTRY_DBUS_PATH, this,
+                                                   QDBusConnection::ExportAllSlots |
+                                                   QDBusConnection::ExportAllSignals);
+}
+
+ShortcutRegistry::~ShortcutRegistry()
+{
+    GList *l;
+
+    QDBusConnection::sessionBus ().unregisterObject (SHORTCUT_REGISTRY_DBUS_PATH);
+
+    gdk_window_remove_filter (gdk_screen_get_root_window (mScreens.first ()), filter, this);
+
+    for (l = mEntries; l != NULL; l = l->next)
+        release ((ShortcutEntry *) l->data);
+    if (mBatch)
+        grab_key_batch_finish (mBatch, NULL, NULL);
+    mBatch = NULL;
+
+    g_list_free_full (mEntries, shortcut_entry_free);
+    g_list_free_full (mDead, shortcut_entry_free);
+    g_hash_table_destroy (mClaims);
+    key_index_free (mIndex);
+    mScreens.clear ();
+}
+
+ShortcutRegistry *ShortcutRegistry::instance()
+{
+    if (nullptr == mRegistry)
+        mRegistry = new ShortcutRegistry ();
+    return mRegistry;
+}
+
+ShortcutClient *ShortcutRegistry::addClient(const char *owner,
+                                            ShortcutActivateFunc activate,
+                                            ShortcutFailedFunc failed,
+                                            gpointer userData)
+{
+    ShortcutRegistry *registry = instance ();
+    ShortcutClient   *client = g_new0 (ShortcutClient, 1);
+
+    client->owner = g_strdup (owner);
+    client->activate = activate;
+    client->failed = failed;
+    client->user_data = userData;
+    registry->mClients = g_list_append (registry->mClients, client);
+
+    return client;
+}
+
+void ShortcutRegistry::removeClient(ShortcutClient *client)
+{
+    ShortcutRegistry *registry = mRegistry;
+    GList *l, *next;
+
+    if (!registry || !client)
+        return;
+
+    for (l = registry->mEntries; l != NULL; l = next) {
+        ShortcutEntry *entry = (ShortcutEntry *) l->data;
+
+        next = l->next;
+        if (entry->client != client)
+            continue;
+
+        registry->release (entry);
+        registry->mEntries = g_list_delete_link (registry->mEntries, l);
+        registry->mDead = g_list_prepend (registry->mDead, entry);
+        registry->mChanged = true;
+    }
+    registry->promote ();
+    commit ();
+
+    registry->mClients = g_list_remove (registry->mClients, client);
+    g_free (client->owner);
+    g_free (client);
+
+    if (registry->mClients == NULL) {
+        delete registry;
+        mRegistry = nullptr;
+    }
+}
+
+/**
+ * @brief ShortcutRegistry::add
+ * 注册快捷键。组合键空闲时立即发出抓取请求，
+ * 否则排在当前持有者之后，持有者注销时自动顶替。
+ */
+bool ShortcutRegistry::add(ShortcutClient *client, const char *accel, const Key *key, gpointer data)
+{
+    ShortcutRegistry *registry = mRegistry;
+    ShortcutEntry    *entry;
+    gint              n;
+
+    if (!registry || !client || !key || !key->keycodes)
+        return false;
+
+    entry = g_new0 (ShortcutEntry, 1);
+    entry->client = client;
+    entry->accel = g_strdup (accel);
+    entry->data = data;
+    entry->key.keysym = key->keysym;
+    entry->key.state = key->state;
+
+    for (n = 0; key->keycodes[n]; ++n);
+    entry->key.keycodes = g_new0 (guint, n + 1);
+    memcpy (entry->key.keycodes, key->keycodes, n * sizeof (guint));
+
+    registry->mEntries = g_list_append (registry->mEntries, entry);
+    registry->mChanged = true;
+
+    if (!registry->isFree (&entry->key)) {
+        qDebug ("Shortcut '%s' of %s is already in use", entry->accel, client->owner);
+        return false;
+    }
+
+    registry->claim (entry);
+    return true;
+}
+
+void ShortcutRegistry::remove(ShortcutClient *client, gpointer data)
+{
+    ShortcutRegistry *registry = mRegistry;
+    GList *l;
+
+    if (!registry)
+        return;
+
+    for (l = registry->mEntries; l != NULL; l = l->next) {
+        ShortcutEntry *entry = (ShortcutEntry *) l->data;
+
+        if (entry->client != client || entry->data != data)
+            continue;
+
+        registry->release (entry);
+        registry->mEntries = g_list_delete_link (registry->mEntries, l);
+        /* 抓取失败的回调可能还引用它，commit() 之后再释放 */
+        registry->mDead = g_list_prepend (registry->mDead, entry);
+        registry->mChanged = true;
+        registry->promote ();
+        return;
+    }
+}
+
+/**
+ * @brief ShortcutRegistry::commit
+ * 一次性等待所有抓取请求的结果，并重建分发索引。
+ * 返回主循环之前必须调用，否则事件可能分发给已移除的快捷键。
+ */
+void ShortcutRegistry::commit()
+{
+    ShortcutRegistry *registry = mRegistry;
+    GList *l;
+
+    if (!registry)
+        return;
+
+    if (registry->mBatch) {
+        grab_key_batch_finish (registry->mBatch, grabFailed, registry);
+        registry->mBatch = NULL;
+    }
+
+    g_list_free_full (registry->mDead, shortcut_entry_free);
+    registry->mDead = NULL;
+
+    if (!registry->mChanged)
+        return;
+
+    key_index_clear (registry->mIndex);
+    for (l = registry->mEntries; l != NULL; l = l->next) {
+        ShortcutEntry *entry = (ShortcutEntry *) l->data;
+
+        if (entry->active)
+            key_index_add (registry->mIndex, &entry->key, entry);
+    }
+
+    registry->mChanged = false;
+
+    /* 重新加载快捷键通常不改变冲突，只在冲突确实变化时通知 */
+    QVariantMap conflicts = registry->collect (true);
+    if (conflicts != registry->mConflicts) {
+        registry->mConflicts = conflicts;
+        Q_EMIT registry->conflictsChanged ();
+    }
+}
+
+bool ShortcutRegistry::isFree(const Key *key)
+{
+    guint *c;
+
+    for (c = key->keycodes; *c; ++c) {
+        gint64 hash_key = claim_key (*c, key->state);
+
+        if (g_hash_table_contains (mClaims, &hash_key))
+            return false;
+    }
+    return true;
+}
+
+void ShortcutRegistry::claim(ShortcutEntry *entry)
+{
+    guint *c;
+
+    if (!mBatch)
+        mBatch = grab_key_batch_new (&mScreens);
+    grab_key_batch_add (mBatch, &entry->key, true, entry);
+
+    for (c = entry->key.keycodes; *c; ++c) {
+        gint64 *hash_key = g_new (gint64, 1);
+
+        *hash_key = claim_key (*c, entry->key.state);
+        g_hash_table_insert (mClaims, hash_key, entry);
+    }
+    entry->active = true;
+    entry->failed = false;
+}
+
+void ShortcutRegistry::release(ShortcutEntry *entry)
+{
+    guint *c;
+
+    if (!entry->active)
+        return;
+
+    if (!mBatch)
+        mBatch = grab_key_batch_new (&mScreens);
+    grab_key_batch_add (mBatch, &entry->key, false, entry);
+
+    for (c = entry->key.keycodes; *c; ++c) {
+        gint64 hash_key = claim_key (*c, entry->key.state);
+
+        if (g_hash_table_lookup (mClaims, &hash_key) == entry)
+            g_hash_table_remove (mClaims, &hash_key);
+    }
+    entry->active = false;
+    entry->failed = false;
+}
+
+/* 按注册顺序让等待中的快捷键接手空出来的组合键 */
+void ShortcutRegistry::promote()
+{
+    GList *l;
+
+    for (l = mEntries; l != NULL; l = l->next) {
+        ShortcutEntry *entry = (ShortcutEntry *) l->data;
+
+        if (!entry->active && isFree (&entry->key))
+            claim (entry);
+    }
+}
+
+void ShortcutRegistry::grabFailed(Key *key, gpointer data, gpointer userData)
+{
+    ShortcutEntry *entry = (ShortcutEntry *) data;
+
+    /* 在同一批次中已被释放 */
+    if (!entry->active)
+        return;
+
+    entry->failed = true;
+    if (entry->client->failed)
+        entry->client->failed (entry->accel, entry->data, entry->client->user_data);
+}
+
+GdkFilterReturn ShortcutRegistry::filter(GdkXEvent *xevent, GdkEvent *event, gpointer data)
+{
+    ShortcutRegistry *registry = (ShortcutRegistry *) data;
+    XEvent   *xev = (XEvent *) xevent;
+    gpointer  match = NULL;
+
+    if (xev->type != KeyPress && xev->type != KeyRelease)
+        return GDK_FILTER_CONTINUE;
+
+    if (!key_index_lookup (registry->mIndex, xev, &match))
+        return GDK_FILTER_CONTINUE;
+
+    ShortcutEntry *entry = (ShortcutEntry *) match;
+    return entry->client->activate (xev, entry->data, entry->client->user_data);
+}
+
+QVariantMap ShortcutRegistry::collect(bool conflictsOnly)
+{
+    QMap<QString, QStringList> owners;
+    QMap<QString, bool>        failed;
+    QVariantMap                result;
+    GList *l;
+
+    for (l = mEntries; l != NULL; l = l->next) {
+        ShortcutEntry *entry = (ShortcutEntry *) l->data;
+        QString        accel = normalized_accel (&entry->key);
+        QString        name = QString ("%1/%2").arg (entry->client->owner).arg (entry->accel);
+
+        if (entry->active) {
+            owners[accel].prepend (name);
+            failed[accel] = entry->failed;
+        } else {
+            owners[accel].append (name);
+        }
+    }
+
+    for (QMap<QString, QStringList>::iterator it = owners.begin (); it != owners.end (); ++it) {
+        if (conflictsOnly && it.value ().size () < 2 && !failed.value (it.key ()))
+            continue;
+        result.insert (it.key (), it.value ());
+    }
+    return result;
+}
+
+QVariantMap ShortcutRegistry::shortcuts()
+{
+    return collect (false);
+}
+
+QVariantMap ShortcutRegistry::conflicts()
+{
+    return collect (true);
+}
+
+QString ShortcutRegistry::owner(const QString &accel)
+{
+    Key    key = { 0, 0, NULL };
+    GList *l;
+    QString name;
+
+    if (!egg_accelerator_parse_virtual (accel.toUtf8 ().data (), &key.keysym, &key.keycodes,
+                                        (EggVirtualModifierType *) &key.state))
+        return QString ();
+
+    name = normalized_accel (&key);
+    g_free (key.keycodes);
+
+    for (l = mEntries; l != NULL; l = l->next) {
+        ShortcutEntry *entry = (ShortcutEntry *) l->data;
+
+        if (entry->active && normalized_accel (&entry->key) == name)
+            return QString::fromUtf8 (entry->client->owner);
+    }
+    return QString ();
+}
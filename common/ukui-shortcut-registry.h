@@ -0,0 +1,110 @@
+/* -*- Mode: C++; indent-tabs-mode: nil; tab-width: 4 -*-
+ * -*- coding: utf-8 -*-
+ *
+ * Copyright (C) 2020 KylinSoft Co., Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef UKUISHORTCUTREGISTRY_H
+#define UKUISHORTCUTREGISTRY_H
+
+#include <QObject>
+#include <QString>
+#include <QVariantMap>
+
+#include "ukui-keygrab.h"
+
+#define SHORTCUT_REGISTRY_DBUS_PATH         "/org/ukui/SettingsDaemon/Shortcuts"
+#define SHORTCUT_REGISTRY_DBUS_INTERFACE    "org.ukui.SettingsDaemon.Shortcuts"
+
+typedef struct _ShortcutClient ShortcutClient;
+struct ShortcutEntry;
+
+/* 快捷键触发，data 为 add() 时传入的数据，返回值决定事件是否继续传递 */
+typedef GdkFilterReturn (*ShortcutActivateFunc) (XEvent *event, gpointer data, gpointer user_data);
+/* 按键已被其他 X 客户端占用 */
+typedef void (*ShortcutFailedFunc) (const char *accel, gpointer data, gpointer user_data);
+
+/**
+ * 进程内全局快捷键注册表
+ * 所有插件的被动按键抓取都由注册表持有：同一组合键只抓取一次，
+ * 只安装一个根窗口过滤器，按键事件经一次索引查找分发给所属插件。
+ *
+ * 同一组合键被多次注册时，先注册者持有抓取，后注册者排队等待，
+ * 持有者注销后依次顶替。占用和冲突信息通过 D-Bus 提供。
+ *
+ * 插件以 QLibrary::ExportExternalSymbolsHint 加载，
+ * 因此所有插件使用的是同一个注册表。
+ */
+class ShortcutRegistry : public QObject
+{
+    Q_OBJECT
+    Q_CLASSINFO("D-Bus Interface", SHORTCUT_REGISTRY_DBUS_INTERFACE)
+
+public:
+    static ShortcutClient *addClient(const char *owner,
+                                     ShortcutActivateFunc activate,
+                                     ShortcutFailedFunc failed,
+                                     gpointer userData);
+    /* 释放客户端注册的所有快捷键，最后一个客户端移除时注册表随之销毁 */
+    static void removeClient(ShortcutClient *client);
+
+    /* 注册快捷键，key 会被复制；返回 false 表示组合键已被占用，进入等待 */
+    static bool add(ShortcutClient *client, const char *accel, const Key *key, gpointer data);
+    static void remove(ShortcutClient *client, gpointer data);
+    /* 等待 add()/remove() 产生的抓取请求完成并更新分发索引 */
+    static void commit();
+
+public Q_SLOTS:
+    /* 组合键 -> 注册者列表（"插件/组合键"），第一个持有抓取 */
+    QVariantMap shortcuts();
+    /* 只包含被多次注册或被其他程序占用的组合键 */
+    QVariantMap conflicts();
+    QString owner(const QString &accel);
+
+Q_SIGNALS:
+    void conflictsChanged();
+
+private:
+    ShortcutRegistry();
+    ~ShortcutRegistry();
+    ShortcutRegistry(const ShortcutRegistry&) = delete;
+    ShortcutRegistry& operator= (const ShortcutRegistry&) = delete;
+
+    static ShortcutRegistry *instance();
+
+    void claim(ShortcutEntry *entry);
+    void release(ShortcutEntry *entry);
+    void promote();
+    bool isFree(const Key *key);
+    QVariantMap collect(bool conflictsOnly);
+
+    static GdkFilterReturn filter(GdkXEvent *xevent, GdkEvent *event, gpointer data);
+    static void grabFailed(Key *key, gpointer data, gpointer userData);
+
+private:
+    static ShortcutRegistry *mRegistry;
+
+    GList           *mClients;
+    GList           *mEntries;      /* ShortcutEntry，按注册顺序 */
+    GList           *mDead;         /* 已移除、等待 commit() 释放的条目 */
+    GHashTable      *mClaims;       /* (keycode, state) -> 持有抓取的 ShortcutEntry */
+    KeyIndex        *mIndex;
+    KeyGrabBatch    *mBatch;
+    QList<GdkScreen*> mScreens;
+    bool             mChanged;
+    QVariantMap      mConflicts;    /* 上次通知时的冲突，用于判断冲突是否变化 */
+};
+
+#endif // UKUISHORTCUTREGISTRY_H
@@ -78,7 +78,8 @@ SetInt (QGSettings      *settings,
          int             val)
 {
     int  pre_val = settings->get(key).toInt();
-    settings->set(key,val);
+    if (val != pre_val)
+        settings->set(key,val);
 
 #ifdef DEBUG_ACCESSIBILITY
         if (val != pre_val) {
@@ -96,7 +97,8 @@ SetBool (QGSettings      *settings,
         bool bval = (val != 0);
         bool pre_val = settings->get(key).toBool();
 
-        settings->set(key,bval ? true : false);
+        if (bval != pre_val)
+                settings->set(key,bval ? true : false);
 
 #ifdef DEBUG_ACCESSIBILITY
         if (bval != pre_val) {
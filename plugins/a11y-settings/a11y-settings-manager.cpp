@@ -18,19 +18,20 @@
  */
 #include "a11y-settings-manager.h"
 #include "clib-syslog.h"
+#include "ukui-settings-pool.h"
 
 A11ySettingsManager* A11ySettingsManager::mA11ySettingsManager = nullptr;
 
 A11ySettingsManager::A11ySettingsManager()
 {
-    interface_settings = new QGSettings("org.mate.interface");
-    a11y_apps_settings = new QGSettings("org.gnome.desktop.a11y.applications");
+    interface_settings = SettingsPool::ref("org.mate.interface");
+    a11y_apps_settings = SettingsPool::ref("org.gnome.desktop.a11y.applications");
 }
 
 A11ySettingsManager::~A11ySettingsManager()
 {
-    delete interface_settings;
-    delete a11y_apps_settings;
+    SettingsPool::unref(interface_settings);
+    SettingsPool::unref(a11y_apps_settings);
 }
 
 A11ySettingsManager* A11ySettingsManager::A11ySettingsManagerNew()
@@ -20,6 +20,7 @@
 #include <QApplication>
 #include <QX11Info>
 #include "background-manager.h"
+#include "ukui-display-coordinator.h"
 #include <Imlib2.h>
 
 #define BACKGROUND          "org.mate.background"
@@ -36,6 +37,7 @@ BackgroundManager::BackgroundManager()
 
 BackgroundManager::~BackgroundManager()
 {
+    DisplayCoordinator::removeStage(DISPLAY_STAGE_WALLPAPER, WallpaperStage, this);
     if(bSettingOld)
         delete bSettingOld;
     XCloseDisplay(dpy);
@@ -51,7 +53,7 @@ void BackgroundManager::initGSettings(){
     connect(qApp,SIGNAL(screenAdded(QScreen *)),
             this, SLOT(screenAddedProcess(QScreen*)));
 
-    connect(qApp, SLOT(screenRemoved(QScreen *)),
+    connect(qApp, SIGNAL(screenRemoved(QScreen *)),
             this, SLOT(screenRemovedProcess(QScreen *)));
 
     connect(m_screen, &QScreen::virtualGeometryChanged, this,
@@ -119,22 +121,31 @@ void BackgroundManager::setup_Background(const QString &key)
     SetBackground();
 }
 
+/* 屏幕变化由 DisplayCoordinator 合并，布局确定后只重绘一次 */
 void BackgroundManager::screenAddedProcess(QScreen *screen)
 {
-    SetBackground();
+    DisplayCoordinator::queueChange();
 }
 
 void BackgroundManager::screenRemovedProcess(QScreen *screen)
 {
-    SetBackground();
+    DisplayCoordinator::queueChange();
 }
 
 void BackgroundManager::virtualGeometryChangedProcess(const QRect &geometry)
 {
-     SetBackground();
+    DisplayCoordinator::queueChange();
+}
+
+bool BackgroundManager::WallpaperStage(gpointer data)
+{
+    ((BackgroundManager *) data)->SetBackground();
+    return false;
 }
+
 void BackgroundManager::BackgroundManagerStart()
 {
     initGSettings();
+    DisplayCoordinator::addStage(DISPLAY_STAGE_WALLPAPER, WallpaperStage, this);
     SetBackground();
 }
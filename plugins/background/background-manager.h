@@ -23,6 +23,7 @@
 #include <QDebug>
 #include <QScreen>
 #include <X11/Xlib.h>
+#include <glib.h>
 
 class BackgroundManager : public QObject
 {
@@ -39,6 +40,7 @@ public:
 private:
     void scaleBg(const QRect &geometry);
     void virtualGeometryChangedProcess(const QRect &geometry);
+    static bool WallpaperStage(gpointer data);
 
 public Q_SLOTS:
     void setup_Background(const QString &key);
@@ -16,14 +16,23 @@
  * You should have received a copy of the GNU General Public License
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
+#include <string.h>
+
 #include "color-state.h"
 #include "config.h"
+#include "ukui-display-coordinator.h"
+
+/* 输出对应的 colord 设备和已连接的默认 profile；device 为 NULL 表示 colord 中没有该输出 */
+typedef struct {
+        CdDevice        *device;
+        CdProfile       *profile;
+} SessionOutputProfile;
 
+/* 按 profile 和 gamma 表大小缓存的 VCGT 采样，size 个 R，随后 G、B，取值 0..1 */
 typedef struct {
-        guint32          red;
-        guint32          green;
-        guint32          blue;
-} MateRROutputClutItem;
+        guint            size;
+        gfloat          *curves;
+} SessionVcgt;
 
 typedef struct {
         ColorState          *state;
@@ -36,6 +45,28 @@ typedef struct {
 #define USD_ICC_PROFILE_IN_X_VERSION_MAJOR      0
 #define USD_ICC_PROFILE_IN_X_VERSION_MINOR      3
 
+/* 黑体颜色查找表的间隔，中间的色温线性插值 */
+#define USD_BLACKBODY_LUT_STEP                  100     /* Kelvin */
+#define USD_BLACKBODY_LUT_SIZE                  ((USD_COLOR_TEMPERATURE_MAX - USD_COLOR_TEMPERATURE_MIN) / \
+                                                 USD_BLACKBODY_LUT_STEP + 1)
+
+static void
+SessionVcgtFree (SessionVcgt *vcgt)
+{
+        g_free (vcgt->curves);
+        g_free (vcgt);
+}
+
+static void
+SessionOutputProfileFree (SessionOutputProfile *entry)
+{
+        if (entry->device != NULL)
+                g_object_unref (entry->device);
+        if (entry->profile != NULL)
+                g_object_unref (entry->profile);
+        g_free (entry);
+}
+
 ColorState::ColorState()
 {
 #ifdef GDK_WINDOWING_X11
@@ -50,6 +81,24 @@ ColorState::ColorState()
                                        g_free,
                                        g_object_unref);
 
+   /* loading the ICC file and sampling the VCGT is expensive */
+   vcgt_cache = g_hash_table_new_full (g_str_hash,
+                                       g_str_equal,
+                                       g_free,
+                                       (GDestroyNotify) SessionVcgtFree);
+
+   /* temperature changes must not query colord for every output */
+   output_profiles = g_hash_table_new_full (g_str_hash,
+                                            g_str_equal,
+                                            g_free,
+                                            (GDestroyNotify) SessionOutputProfileFree);
+
+   /* the last ramp uploaded to each CRTC */
+   crtc_ramps = g_hash_table_new_full (g_direct_hash,
+                                       g_direct_equal,
+                                       NULL,
+                                       (GDestroyNotify) g_bytes_unref);
+
    /* we don't want to assign devices multiple times at startup */
    device_assign_hash = g_hash_table_new_full (g_str_hash,
                                                g_str_equal,
@@ -69,6 +118,9 @@ ColorState::~ColorState()
     g_clear_object (&cancellable);
     g_clear_object (&client);
     g_clear_pointer (&edid_cache, g_hash_table_destroy);
+    g_clear_pointer (&vcgt_cache, g_hash_table_destroy);
+    g_clear_pointer (&output_profiles, g_hash_table_destroy);
+    g_clear_pointer (&crtc_ramps, g_hash_table_destroy);
     g_clear_pointer (&device_assign_hash, g_hash_table_destroy);
     g_clear_object (&state_screen);
 }
@@ -326,99 +378,150 @@ SessionAsyncHelperFree (SessionAsyncHelper *helper)
         g_free (helper);
 }
 
-static gboolean
-SessionOutputSetGamma (MateRROutput *output,
-                       GPtrArray *array)
+/**
+ * 由 0..1 的曲线和色温系数生成 R、G、B 连续存放的 gamma 表，
+ * curves 为 NULL 时使用线性曲线。
+ * 内层循环没有分支和函数调用，编译器可以向量化
+ */
+static void
+SessionBuildRamp (const gfloat *curves, const CdColorRGB *temp,
+                  guint size, guint16 *ramp)
+{
+        const gfloat scale[3] = { (gfloat) (temp->R * 0xffff),
+                                  (gfloat) (temp->G * 0xffff),
+                                  (gfloat) (temp->B * 0xffff) };
+        guint c, i;
+
+        for (c = 0; c < 3; c++) {
+                guint16 *out = ramp + c * size;
+                gfloat   s = scale[c];
+
+                if (curves != NULL) {
+                        const gfloat *in = curves + c * size;
+                        for (i = 0; i < size; i++)
+                                out[i] = (guint16) (in[i] * s);
+                } else {
+                        gfloat step = s / (gfloat) (size - 1);
+                        for (i = 0; i < size; i++)
+                                out[i] = (guint16) ((gfloat) i * step);
+                }
+        }
+}
+
+/**
+ * 色温对应的黑体颜色。
+ * 首次使用时按 USD_BLACKBODY_LUT_STEP 间隔计算整张表，之后只做线性插值，
+ * 夜间模式渐变的每一步都不再重新计算普朗克曲线
+ */
+static void
+SessionGetBlackbody (guint temperature, CdColorRGB *result)
+{
+        static CdColorRGB lut[USD_BLACKBODY_LUT_SIZE];
+        static gboolean   lut_valid = FALSE;
+        guint   index;
+        gdouble frac;
+
+        if (!lut_valid) {
+                for (index = 0; index < USD_BLACKBODY_LUT_SIZE; index++) {
+                        guint t = USD_COLOR_TEMPERATURE_MIN + index * USD_BLACKBODY_LUT_STEP;
+                        if (!cd_color_get_blackbody_rgb_full (t, &lut[index],
+                                                              CD_COLOR_BLACKBODY_FLAG_USE_PLANCKIAN)) {
+                                qWarning ("failed to get blackbody for %uK", t);
+                                cd_color_rgb_set (&lut[index], 1.0, 1.0, 1.0);
+                        }
+                }
+                lut_valid = TRUE;
+        }
+
+        temperature = CLAMP (temperature, USD_COLOR_TEMPERATURE_MIN, USD_COLOR_TEMPERATURE_MAX);
+        index = (temperature - USD_COLOR_TEMPERATURE_MIN) / USD_BLACKBODY_LUT_STEP;
+        if (index >= USD_BLACKBODY_LUT_SIZE - 1) {
+                *result = lut[USD_BLACKBODY_LUT_SIZE - 1];
+                return;
+        }
+        frac = (gdouble) ((temperature - USD_COLOR_TEMPERATURE_MIN) % USD_BLACKBODY_LUT_STEP) /
+               USD_BLACKBODY_LUT_STEP;
+        result->R = lut[index].R + (lut[index + 1].R - lut[index].R) * frac;
+        result->G = lut[index].G + (lut[index + 1].G - lut[index].G) * frac;
+        result->B = lut[index].B + (lut[index + 1].B - lut[index].B) * frac;
+}
+
+/**
+ * 把 ramp 写入输出所在的 CRTC。
+ * 与上次写入这个 CRTC 的表相同时跳过；请求只进入 Xlib 的缓冲区，
+ * 由调用者在一轮设置结束后一起发送
+ */
+bool ColorState::SessionOutputSetGamma (ColorState *state,
+                                        MateRROutput *output,
+                                        guint16 *ramp,
+                                        guint size)
 {
-        gboolean ret = TRUE;
-        guint16 *red = NULL;
-        guint16 *green = NULL;
-        guint16 *blue = NULL;
-        guint i;
-        MateRROutputClutItem *data;
         MateRRCrtc *crtc;
+        GBytes *last;
+        gsize bytes = 3 * size * sizeof (guint16);
+        gpointer key;
 
         /* no length? */
-        if (array->len == 0) {
-            ret = FALSE;
+        if (size == 0) {
             qDebug("no data in the CLUT array");
-            goto out;
-        }
-
-        /* convert to a type X understands */
-        red = g_new (guint16, array->len);
-        green = g_new (guint16, array->len);
-        blue = g_new (guint16, array->len);
-        for (i = 0; i < array->len; i++) {
-                data = (MateRROutputClutItem *)g_ptr_array_index (array, i);
-                red[i] = data->red;
-                green[i] = data->green;
-                blue[i] = data->blue;
+            return false;
         }
 
         /* send to LUT */
         crtc = mate_rr_output_get_crtc (output);
         if (crtc == NULL) {
-            ret = FALSE;
             qDebug("failed to get ctrc for %s",mate_rr_output_get_name (output));
-            goto out;
+            return false;
         }
-        mate_rr_crtc_set_gamma (crtc, array->len,
-                                 red, green, blue);
-out:
-        g_free (red);
-        g_free (green);
-        g_free (blue);
-        return ret;
-}
 
+        key = GUINT_TO_POINTER (mate_rr_crtc_get_id (crtc));
+        last = (GBytes *) g_hash_table_lookup (state->crtc_ramps, key);
+        if (last != NULL && g_bytes_get_size (last) == bytes &&
+            memcmp (g_bytes_get_data (last, NULL), ramp, bytes) == 0)
+                return true;
+
+        mate_rr_crtc_set_gamma (crtc, size,
+                                 ramp, ramp + size, ramp + 2 * size);
+        g_hash_table_insert (state->crtc_ramps, key, g_bytes_new (ramp, bytes));
+        return true;
+}
 
-bool ColorState::SessionDeviceResetGamma(MateRROutput *output,
-                                         guint color_temperature)
+/**
+ * 按输出的 profile 和当前色温设置 gamma 表。
+ * profile 带 VCGT 时使用其曲线，否则（包括没有 profile 时）使用线性曲线
+ */
+bool ColorState::SessionApplyOutputGamma (ColorState *state,
+                                          MateRROutput *output,
+                                          CdProfile *profile)
 {
         bool ret;
-        guint i;
         guint size;
-        guint32 value;
-        GPtrArray *clut;
-        MateRROutputClutItem *data;
+        guint16 *ramp;
+        const gfloat *curves = NULL;
         CdColorRGB temp;
 
-        /* create a linear ramp */
-        qDebug ("falling back to dummy ramp");
-        clut = g_ptr_array_new_with_free_func (g_free);
         size = MateRrOutputGetGammaSize (output);
-        if (size == 0) {
-                ret = true;
-                goto out;
+        if (size == 0)
+                return true;
+
+        if (profile != NULL && cd_profile_get_has_vcgt (profile)) {
+                curves = SessionGetVcgtCurves (state, profile, size);
+                if (curves == NULL) {
+                        qDebug("failed to generate vcgt");
+                        return false;
+                }
         }
 
         /* get the color temperature */
-        if (!cd_color_get_blackbody_rgb_full (color_temperature,
-                                              &temp,
-                                              CD_COLOR_BLACKBODY_FLAG_USE_PLANCKIAN)) {
-                qWarning ("failed to get blackbody for %uK", color_temperature);
-                cd_color_rgb_set (&temp, 1.0, 1.0, 1.0);
-        } else {
-                qDebug ("using reset gamma of %uK = %.1f,%.1f,%.1f",
-                         color_temperature, temp.R, temp.G, temp.B);
-        }
+        SessionGetBlackbody (state->color_temperature, &temp);
 
-        for (i = 0; i < size; i++) {
-                value = (i * 0xffff) / (size - 1);
-                data = g_new0 (MateRROutputClutItem, 1);
-                data->red = value * temp.R;
-                data->green = value * temp.G;
-                data->blue = value * temp.B;
-                g_ptr_array_add (clut, data);
-        }
+        /* create a lookup table */
+        ramp = g_new (guint16, 3 * size);
+        SessionBuildRamp (curves, &temp, size, ramp);
 
         /* apply the vcgt to this output */
-        ret = SessionOutputSetGamma (output, clut);
-        if (!ret)
-                goto out;
-out:
-        g_ptr_array_unref (clut);
+        ret = SessionOutputSetGamma (state, output, ramp, size);
+        g_free (ramp);
         return ret;
 }
 
@@ -731,21 +834,32 @@ bool ColorState::SessionScreenSetIccProfile (ColorState *state,
 }
 
 
-static GPtrArray *
-SessionGenerateVcgt (CdProfile *profile, guint color_temperature, guint size)
+/**
+ * 取得 profile 的 VCGT 按 size 采样后的曲线。
+ * 只在第一次使用某个 profile 和 gamma 表大小时读取 ICC 文件，
+ * 夜间模式渐变时不再有文件读写
+ */
+const gfloat *ColorState::SessionGetVcgtCurves (ColorState *state,
+                                                CdProfile *profile,
+                                                guint size)
 {
-        MateRROutputClutItem *tmp;
-        GPtrArray *array = NULL;
         const cmsToneCurve **vcgt;
-        cmsFloat32Number in;
-        guint i;
         cmsHPROFILE lcms_profile;
+        SessionVcgt *cached;
         CdIcc *icc = NULL;
-        CdColorRGB temp;
+        gchar *key;
+        guint c, i;
 
         /* invalid size */
         if (size == 0)
-                goto out;
+                return NULL;
+
+        key = g_strdup_printf ("%s:%u", cd_profile_get_filename (profile), size);
+        cached = (SessionVcgt *) g_hash_table_lookup (state->vcgt_cache, key);
+        if (cached != NULL) {
+                g_free (key);
+                return cached->curves;
+        }
 
         /* open file */
         icc = cd_profile_load_icc (profile, CD_ICC_LOAD_FLAGS_NONE, NULL, NULL);
@@ -760,63 +874,40 @@ SessionGenerateVcgt (CdProfile *profile, guint color_temperature, guint size)
                 goto out;
         }
 
-        /* get the color temperature */
-        if (!cd_color_get_blackbody_rgb_full (color_temperature,
-                                              &temp,
-                                              CD_COLOR_BLACKBODY_FLAG_USE_PLANCKIAN)) {
-                qWarning ("failed to get blackbody for %uK", color_temperature);
-                cd_color_rgb_set (&temp, 1.0, 1.0, 1.0);
-        } else {
-                qDebug ("using VCGT gamma of %uK = %.1f,%.1f,%.1f",
-                         color_temperature, temp.R, temp.G, temp.B);
-        }
-
-        /* create array */
-        array = g_ptr_array_new_with_free_func (g_free);
-        for (i = 0; i < size; i++) {
-                in = (gdouble) i / (gdouble) (size - 1);
-                tmp = g_new0 (MateRROutputClutItem, 1);
-                tmp->red = cmsEvalToneCurveFloat(vcgt[0], in) * temp.R * (gdouble) 0xffff;
-                tmp->green = cmsEvalToneCurveFloat(vcgt[1], in) * temp.G * (gdouble) 0xffff;
-                tmp->blue = cmsEvalToneCurveFloat(vcgt[2], in) * temp.B * (gdouble) 0xffff;
-                g_ptr_array_add (array, tmp);
+        cached = g_new0 (SessionVcgt, 1);
+        cached->size = size;
+        cached->curves = g_new (gfloat, 3 * size);
+        for (c = 0; c < 3; c++) {
+                for (i = 0; i < size; i++) {
+                        cmsFloat32Number in = (gdouble) i / (gdouble) (size - 1);
+                        cached->curves[c * size + i] = cmsEvalToneCurveFloat (vcgt[c], in);
+                }
         }
+        g_hash_table_insert (state->vcgt_cache, key, cached);
+        key = NULL;
 out:
+        g_free (key);
         if (icc != NULL)
                 g_object_unref (icc);
-        return array;
+        return cached != NULL ? cached->curves : NULL;
 }
 
 
-static gboolean
-SessionDeviceSetGamma (MateRROutput *output,
-                       CdProfile *profile,
-                       guint color_temperature)
+/* 记下输出对应的设备和 profile，之后改变色温时直接使用 */
+void ColorState::SessionRememberOutputProfile (ColorState *state,
+                                               MateRROutput *output,
+                                               CdDevice *device,
+                                               CdProfile *profile)
 {
-        gboolean ret = FALSE;
-        guint size;
-        GPtrArray *clut = NULL;
-
-        /* create a lookup table */
-        size = MateRrOutputGetGammaSize (output);
-        if (size == 0) {
-                ret = TRUE;
-                goto out;
-        }
-        clut = SessionGenerateVcgt (profile, color_temperature, size);
-        if (clut == NULL) {
-                qDebug("failed to generate vcgt");
-                goto out;
-        }
+        SessionOutputProfile *entry = g_new0 (SessionOutputProfile, 1);
 
-        /* apply the vcgt to this output */
-        ret = SessionOutputSetGamma (output, clut);
-        if (!ret)
-                goto out;
-out:
-        if (clut != NULL)
-                g_ptr_array_unref (clut);
-        return ret;
+        if (device != NULL)
+                entry->device = (CdDevice *) g_object_ref (device);
+        if (profile != NULL)
+                entry->profile = (CdProfile *) g_object_ref (profile);
+        g_hash_table_insert (state->output_profiles,
+                             g_strdup (mate_rr_output_get_name (output)),
+                             entry);
 }
 
 
@@ -867,26 +958,15 @@ void ColorState::SessionDeviceAssignProfileConnectCb (GObject *object,
                 }
         }
 
-        /* create a vcgt for this icc file */
-        ret = cd_profile_get_has_vcgt (profile);
-        if (ret) {
-                ret = SessionDeviceSetGamma (output,
-                                             profile,
-                                             state->color_temperature);
-                if (!ret) {
-                        qWarning ("failed to set %s gamma tables",
-                                   cd_device_get_id (helper->device));
-                        goto out;
-                }
-        } else {
-                ret = SessionDeviceResetGamma (output,
-                                               state->color_temperature);
-                if (!ret) {
-                        qWarning ("failed to reset %s gamma tables",
-                                   cd_device_get_id (helper->device));
-                        goto out;
-                }
+        /* create a vcgt for this icc file, or reset to a linear ramp */
+        SessionRememberOutputProfile (state, output, helper->device, profile);
+        ret = SessionApplyOutputGamma (state, output, profile);
+        if (!ret) {
+                qWarning ("failed to set %s gamma tables",
+                           cd_device_get_id (helper->device));
+                goto out;
         }
+        gdk_display_flush (gdk_display_get_default ());
 out:
         SessionAsyncHelperFree (helper);
 }
@@ -999,8 +1079,9 @@ void ColorState::SessionDeviceAssignConnectCb (GObject *object,
         }
 
         /* reset, as we want linear profiles for profiling */
-        ret = SessionDeviceResetGamma (output,
-                                       state->color_temperature);
+        SessionRememberOutputProfile (state, output, device, NULL);
+        ret = SessionApplyOutputGamma (state, output, NULL);
+        gdk_display_flush (gdk_display_get_default ());
         if (!ret) {
                 qWarning ("failed to reset %s gamma tables",
                            cd_device_get_id (device));
@@ -1014,7 +1095,7 @@ void ColorState::SessionDeviceAssignConnectCb (GObject *object,
     helper->output_id = mate_rr_output_get_id (output);
     if(!helper->state)
         helper->state = state;
-    helper->device = device;
+    helper->device = (CdDevice *) g_object_ref (device);
     cd_profile_connect (profile,
                     state->cancellable,
                     SessionDeviceAssignProfileConnectCb,
@@ -1038,16 +1119,24 @@ void ColorState::SessionProfileGammaFindDeviceCb (GObject *object,
         CdClient *client = CD_CLIENT (object);
         CdDevice *device = NULL;
         GError *error = NULL;
-        ColorState *state = (ColorState *) user_data;
+        MateRROutput *output;
+        SessionAsyncHelper *helper = (SessionAsyncHelper *) user_data;
+        ColorState *state = helper->state;
 
         device = cd_client_find_device_by_property_finish (client,
                                                            res,
                                                            &error);
         if (device == NULL) {
-                if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+                if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
                         qWarning ("could not find device: %s", error->message);
+                        /* colord 中没有这个输出，等 device-added 时再设置 */
+                        output = mate_rr_screen_get_output_by_id (state->state_screen,
+                                                                   helper->output_id);
+                        if (output != NULL)
+                                SessionRememberOutputProfile (state, output, NULL, NULL);
+                }
                 g_error_free (error);
-                return;
+                goto out;
         }
 
         /* get properties */
@@ -1058,12 +1147,21 @@ void ColorState::SessionProfileGammaFindDeviceCb (GObject *object,
 
         if (device != NULL)
                 g_object_unref (device);
+out:
+        SessionAsyncHelperFree (helper);
 }
 
 
+/**
+ * 按当前色温设置所有输出的 gamma 表。
+ * 已知 colord 设备和 profile 的输出直接计算，不再经过 D-Bus 查询；
+ * 所有 CRTC 的 gamma 请求最后一起发送给 X 服务器
+ */
 void ColorState::SessionSetGammaForAllDevices (ColorState *state)
 {
         MateRROutput **outputs;
+        SessionOutputProfile *entry;
+        SessionAsyncHelper *helper;
         guint i;
 
         /* setting the temperature before we get the list of devices is fine,
@@ -1078,24 +1176,49 @@ void ColorState::SessionSetGammaForAllDevices (ColorState *state)
                 return;
         }
         for (i = 0; outputs[i] != NULL; i++) {
+                entry = (SessionOutputProfile *) g_hash_table_lookup (state->output_profiles,
+                                                                      mate_rr_output_get_name (outputs[i]));
+                if (entry != NULL) {
+                        if (entry->device != NULL &&
+                            !SessionApplyOutputGamma (state, outputs[i], entry->profile))
+                                qWarning ("failed to set %s gamma tables",
+                                           mate_rr_output_get_name (outputs[i]));
+                        continue;
+                }
+
                 /* get CdDevice for this output */
+                helper = g_new0 (SessionAsyncHelper, 1);
+                helper->state = state;
+                helper->output_id = mate_rr_output_get_id (outputs[i]);
                 cd_client_find_device_by_property (state->client,
                                                    CD_DEVICE_METADATA_XRANDR_NAME,
                                                    mate_rr_output_get_name (outputs[i]),
                                                    state->cancellable,
                                                    SessionProfileGammaFindDeviceCb,
-                                                   state);
+                                                   helper);
         }
+        gdk_display_flush (gdk_display_get_default ());
 }
 
 
+/* 一次插拔会产生多个事件，合并后由 GammaStage 在布局确定后统一设置 */
+void ColorState::MateRrScreenOutputChangedCb (MateRRScreen *screen,
+                                              ColorState *state)
+{
+        DisplayCoordinator::queueChange ();
+}
+
 /* We have to reset the gamma tables each time as if the primary output
  * has changed then different crtcs are going to be used.
  * See https://bugzilla.gnome.org/show_bug.cgi?id=660164 for an example */
-void ColorState::MateRrScreenOutputChangedCb (MateRRScreen *screen,
-                                              ColorState *state)
+bool ColorState::GammaStage (gpointer user_data)
 {
+        ColorState *state = (ColorState *) user_data;
+
+        /* 模式设置后 CRTC 的 gamma 表可能已被重置 */
+        g_hash_table_remove_all (state->crtc_ramps);
         SessionSetGammaForAllDevices (state);
+        return false;
 }
 
 void ColorState::SessionDeviceAssign (ColorState *state, CdDevice *device)
@@ -1103,6 +1226,9 @@ void ColorState::SessionDeviceAssign (ColorState *state, CdDevice *device)
         const gchar *key;
         gpointer found;
 
+        /* the device's profiles may have changed */
+        g_hash_table_remove_all (state->vcgt_cache);
+
         /* are we already assigning this device */
         key = cd_device_get_object_path (device);
         found = g_hash_table_lookup (state->device_assign_hash, key);
@@ -1120,6 +1246,25 @@ void ColorState::SessionDeviceAssign (ColorState *state, CdDevice *device)
                            state);
 }
 
+static gboolean
+SessionOutputProfileMatchesDevice (gpointer key, gpointer value, gpointer user_data)
+{
+        SessionOutputProfile *entry = (SessionOutputProfile *) value;
+
+        return entry->device != NULL &&
+               g_strcmp0 (cd_device_get_object_path (entry->device),
+                          (const gchar *) user_data) == 0;
+}
+
+void ColorState::SessionDeviceRemovedCb (CdClient *client,
+                                         CdDevice *device,
+                                         ColorState *state)
+{
+        g_hash_table_foreach_remove (state->output_profiles,
+                                     SessionOutputProfileMatchesDevice,
+                                     (gpointer) cd_device_get_object_path (device));
+}
+
 void ColorState::SessionDeviceAddedAssignCb (CdClient *client,
                                              CdDevice *device,
                                              ColorState *state)
@@ -1208,12 +1353,16 @@ void ColorState::SessionClientConnectCb (GObject *source_object,
     g_signal_connect (state->state_screen, "changed",
                       G_CALLBACK (MateRrScreenOutputChangedCb),
                       state);
+    DisplayCoordinator::addStage (DISPLAY_STAGE_GAMMA, GammaStage, state);
     g_signal_connect (state->client, "device-added",
                       G_CALLBACK (SessionDeviceAddedAssignCb),
                       state);
     g_signal_connect (state->client, "device-changed",
                       G_CALLBACK (SessionDeviceChangedAssignCb),
                       state);
+    g_signal_connect (state->client, "device-removed",
+                      G_CALLBACK (SessionDeviceRemovedCb),
+                      state);
 
     /* set for each device that already exist */
     cd_client_get_devices (state->client,
@@ -1245,4 +1394,7 @@ bool ColorState::ColorStateStart()
 void ColorState::ColorStateStop()
 {
     g_cancellable_cancel (cancellable);
+    DisplayCoordinator::removeStage (DISPLAY_STAGE_GAMMA, GammaStage, this);
+    g_hash_table_remove_all (output_profiles);
+    g_hash_table_remove_all (crtc_ramps);
 }
@@ -74,8 +74,20 @@ public:
                                               GFile *file,
                                               GError **error);
 
-    static bool SessionDeviceResetGamma (MateRROutput *output,
-                                         guint color_temperature);
+    static bool SessionOutputSetGamma (ColorState *state,
+                                       MateRROutput *output,
+                                       guint16 *ramp,
+                                       guint size);
+    static bool SessionApplyOutputGamma (ColorState *state,
+                                         MateRROutput *output,
+                                         CdProfile *profile);
+    static void SessionRememberOutputProfile (ColorState *state,
+                                              MateRROutput *output,
+                                              CdDevice *device,
+                                              CdProfile *profile);
+    static const gfloat *SessionGetVcgtCurves (ColorState *state,
+                                               CdProfile *profile,
+                                               guint size);
     static void SessionDeviceAssignProfileConnectCb (GObject *object,
                                                      GAsyncResult *res,
                                                      gpointer user_data);
@@ -95,17 +107,24 @@ public:
     static void SessionDeviceChangedAssignCb (CdClient *client,
                                               CdDevice *device,
                                               ColorState *stata);
+    static void SessionDeviceRemovedCb (CdClient *client,
+                                        CdDevice *device,
+                                        ColorState *state);
     static void SessionDeviceAddedAssignCb (CdClient *client,
                                             CdDevice *device,
                                             ColorState *state);
     static void MateRrScreenOutputChangedCb (MateRRScreen *screen,
                                              ColorState *state);
+    static bool GammaStage (gpointer user_data);
 
 private:
     GCancellable    *cancellable;
     CdClient        *client;
     MateRRScreen    *state_screen;
     GHashTable      *edid_cache;
+    GHashTable      *vcgt_cache;    /* "profile 文件名:gamma 表大小" -> SessionVcgt */
+    GHashTable      *output_profiles; /* 输出名 -> SessionOutputProfile */
+    GHashTable      *crtc_ramps;    /* CRTC id -> 上次写入的 gamma 表 (GBytes) */
     GdkWindow       *gdk_window;
     GHashTable      *device_assign_hash;
     guint            color_temperature;
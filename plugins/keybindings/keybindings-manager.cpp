@@ -34,7 +34,8 @@ KeybindingsManager *KeybindingsManager::mKeybinding = nullptr;
 
 KeybindingsManager::KeybindingsManager()
 {
-
+    shortcuts = NULL;
+    launch_pool = NULL;
 }
 
 KeybindingsManager::~KeybindingsManager()
@@ -84,6 +85,79 @@ parse_binding (Binding *binding)
     return success;
 }
 
+/**
+ * @brief binding_clear_launcher
+ * Drop the launch data cached for a binding
+ * 释放绑定缓存的启动信息
+ */
+static void
+binding_clear_launcher (Binding *binding)
+{
+    if (binding->monitor) {
+        g_signal_handlers_disconnect_by_data (binding->monitor, binding);
+        g_file_monitor_cancel (binding->monitor);
+        g_clear_object (&binding->monitor);
+    }
+    g_clear_object (&binding->app_info);
+    g_strfreev (binding->argv);
+    binding->argv = NULL;
+}
+
+static void
+binding_load_app_info (Binding *binding)
+{
+    g_clear_object (&binding->app_info);
+    binding->app_info = (GAppInfo *) g_desktop_app_info_new_from_filename (binding->action);
+    if (!binding->app_info)
+        qWarning ("Key binding (%s) can not load '%s'", binding->settings_path, binding->action);
+}
+
+static void
+binding_action_changed (GFileMonitor      *monitor,
+                        GFile             *file,
+                        GFile             *other_file,
+                        GFileMonitorEvent  event,
+                        Binding           *binding)
+{
+    switch (event) {
+    case G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT:
+    case G_FILE_MONITOR_EVENT_CREATED:
+    case G_FILE_MONITOR_EVENT_DELETED:
+        binding_load_app_info (binding);
+        break;
+    default:
+        break;
+    }
+}
+
+/**
+ * @brief binding_load_launcher
+ * Parse the action once when the binding loads, so a key press does no
+ * disk I/O. A .desktop action is reloaded when the file changes.
+ * 绑定加载时解析一次动作，按键时不再读取磁盘；.desktop 文件改变时重新加载
+ */
+static void
+binding_load_launcher (Binding *binding)
+{
+    binding_clear_launcher (binding);
+
+    if (binding->action == NULL || binding->action[0] == '\0')
+        return;
+
+    if (g_str_has_suffix (binding->action, ".desktop")) {
+        GFile *file = g_file_new_for_path (binding->action);
+
+        binding_load_app_info (binding);
+        binding->monitor = g_file_monitor_file (file, G_FILE_MONITOR_NONE, NULL, NULL);
+        if (binding->monitor)
+            g_signal_connect (binding->monitor, "changed",
+                              G_CALLBACK (binding_action_changed), binding);
+        g_object_unref (file);
+    } else if (!g_shell_parse_argv (binding->action, NULL, &binding->argv, NULL)) {
+        binding->argv = NULL;
+    }
+}
+
 static gint
 compare_bindings (gconstpointer a,
                   gconstpointer b)
@@ -133,15 +207,12 @@ bool KeybindingsManager::bindings_get_entry (KeybindingsManager *manager,const c
     if (!tmp_elem) {
         new_binding = g_new0 (Binding, 1);
     } else {
+        /* previous_key keeps the grabbed key, binding_register_keys()
+         * compares it against the newly parsed one */
         new_binding = (Binding *) tmp_elem->data;
         g_free (new_binding->binding_str);
         g_free (new_binding->action);
         g_free (new_binding->settings_path);
-
-        new_binding->previous_key.keysym = new_binding->key.keysym;
-        new_binding->previous_key.state = new_binding->key.state;
-        new_binding->previous_key.keycodes = new_binding->key.keycodes;
-        new_binding->key.keycodes = NULL;
     }
 
     new_binding->binding_str = key;
@@ -149,16 +220,21 @@ bool KeybindingsManager::bindings_get_entry (KeybindingsManager *manager,const c
     new_binding->settings_path = g_strdup (settings_path);
 
     if (parse_binding (new_binding)) {
+        binding_load_launcher (new_binding);
         if (!tmp_elem)
             manager->binding_list = g_slist_prepend (manager->binding_list, new_binding);
     } else {
+        if (tmp_elem) {
+            binding_release_grab (manager, new_binding);
+            manager->binding_list = g_slist_delete_link (manager->binding_list, tmp_elem);
+        }
+        binding_clear_launcher (new_binding);
         g_free (new_binding->binding_str);
         g_free (new_binding->action);
         g_free (new_binding->settings_path);
         g_free (new_binding->previous_key.keycodes);
+        g_free (new_binding->key.keycodes);
         g_free (new_binding);
-        if (tmp_elem)
-            manager->binding_list = g_slist_delete_link (manager->binding_list, tmp_elem);
         return false;
     }
 
@@ -178,6 +254,7 @@ void KeybindingsManager::bindings_clear (KeybindingsManager *manager)
     {
         for (l = manager->binding_list; l; l = l->next) {
             Binding *b = (Binding *)l->data;
+            binding_clear_launcher (b);
             g_free (b->binding_str);
             g_free (b->action);
             g_free (b->settings_path);
@@ -211,26 +288,6 @@ void KeybindingsManager::bindings_get_entries (KeybindingsManager *manager)
     }
 }
 
-/**
- * @brief same_keycode
- * Is it the same key code
- * 是否为相同的键码
- * @return
- */
-static bool
-same_keycode (const Key *key, const Key *other)
-{
-    if (key->keycodes != NULL && other->keycodes != NULL) {
-        unsigned int *c;
-
-        for (c = key->keycodes; *c; ++c) {
-            if (key_uses_keycode (other, *c))
-                return true;
-        }
-    }
-    return false;
-}
-
 /**
  * @brief same_key
  * Compare whether the keys are shortcuts
@@ -257,25 +314,22 @@ static bool same_key (const Key *key, const Key *other)
 }
 
 /**
- * @brief KeybindingsManager::key_already_used
- * @English Compare the shortcuts already used
- * @简体 已经使用的快捷键 进行比对
- * @return
+ * @brief KeybindingsManager::binding_release_grab
+ * Ungrab the key currently held by a binding
+ * 释放绑定当前占用的按键
  */
-bool KeybindingsManager::key_already_used (KeybindingsManager*manager,Binding   *binding)
+void KeybindingsManager::binding_release_grab (KeybindingsManager *manager, Binding *binding)
 {
-    GSList *li;
+    if (!binding->previous_key.keycodes)
+        return;
 
-    for (li = manager->binding_list; li != NULL; li = li->next) {
-        Binding *tmp_binding =  (Binding*) li->data;
+    ShortcutRegistry::remove (manager->shortcuts, binding);
+    ShortcutRegistry::commit ();
 
-        if (tmp_binding != binding &&
-            same_keycode (&tmp_binding->key, &binding->key) &&
-            tmp_binding->key.state == binding->key.state) {
-                return true;
-        }
-    }
-    return false;
+    g_free (binding->previous_key.keycodes);
+    binding->previous_key.keycodes = NULL;
+    binding->previous_key.keysym = 0;
+    binding->previous_key.state = 0;
 }
 
 /**
@@ -286,23 +340,33 @@ bool KeybindingsManager::key_already_used (KeybindingsManager*manager,Binding
 void KeybindingsManager::binding_unregister_keys (KeybindingsManager *manager)
 {
     GSList *li;
-    bool need_flush = FALSE;
-    gdk_x11_display_error_trap_push (gdk_display_get_default());
-    try {
-        for (li = manager->binding_list; li != NULL; li = li->next) {
-            Binding *binding = (Binding *) li->data;
-
-            if (binding->key.keycodes) {
-                need_flush = TRUE;
-                grab_key_unsafe (&binding->key, FALSE, manager->screens);
-            }
-        }
-        if (need_flush)
-            gdk_display_flush(gdk_display_get_default());
-    } catch (...) {
 
+    for (li = manager->binding_list; li != NULL; li = li->next) {
+        Binding *binding = (Binding *) li->data;
+
+        if (binding->previous_key.keycodes) {
+            ShortcutRegistry::remove (manager->shortcuts, binding);
+            g_free (binding->previous_key.keycodes);
+            binding->previous_key.keycodes = NULL;
+            binding->previous_key.keysym = 0;
+            binding->previous_key.state = 0;
+        }
     }
-    gdk_x11_display_error_trap_pop_ignored(gdk_display_get_default());
+    ShortcutRegistry::commit ();
+}
+
+/**
+ * @brief binding_grab_failed
+ * Report a binding whose key could not be grabbed
+ * 报告无法绑定按键的快捷键
+ */
+static void
+binding_grab_failed (const char *accel, gpointer data, gpointer user_data)
+{
+    Binding *binding = (Binding *) data;
+
+    qWarning ("Grab failed for key binding (%s) '%s', another application may already have access to it",
+              binding->settings_path, binding->binding_str);
 }
 
 /**
@@ -313,8 +377,6 @@ void KeybindingsManager::binding_unregister_keys (KeybindingsManager *manager)
 void KeybindingsManager::binding_register_keys (KeybindingsManager *manager)
 {
     GSList *li;
-    bool need_flush = false;
-    gdk_x11_display_error_trap_push (gdk_display_get_default());
     /* Now check for changes and grab new key if not already used
      * 现在检查更改并获取新密钥（如果尚未使用）
      */
@@ -322,93 +384,153 @@ void KeybindingsManager::binding_register_keys (KeybindingsManager *manager)
         Binding *binding = (Binding *) li->data;
         if (!same_key (&binding->previous_key, &binding->key)) {
 
-            /* Ungrab key if it changed and not clashing with previously set binding */
-            if (!key_already_used (manager,binding)) {
+            /* Drop the old key if it changed, previous_key is the registered one */
+            if (binding->previous_key.keycodes) {
+                ShortcutRegistry::remove (manager->shortcuts, binding);
+                g_free (binding->previous_key.keycodes);
+                binding->previous_key.keycodes = NULL;
+                binding->previous_key.keysym = 0;
+                binding->previous_key.state = 0;
+            }
+
+            /* Register the new key, a key already held by another
+             * shortcut waits in the registry until it is released */
+            if (!binding->key.keycodes) {
+                continue;
+            } else {
                 gint i;
-                need_flush = true;
-                if (binding->previous_key.keycodes) {
-                        grab_key_unsafe (&binding->previous_key, FALSE, manager->screens);
-                }
-                grab_key_unsafe (&binding->key, TRUE, manager->screens);
+                if (!ShortcutRegistry::add (manager->shortcuts, binding->binding_str,
+                                            &binding->key, binding))
+                    qDebug ("Key binding (%s) is already in use", binding->binding_str);
                 binding->previous_key.keysym = binding->key.keysym;
                 binding->previous_key.state = binding->key.state;
-                g_free (binding->previous_key.keycodes);
-
-                for (i = 0; binding->key.keycodes&&binding->key.keycodes[i]; ++i);
-                binding->previous_key.keycodes = g_new0 (guint, i);
 
-                for (i = 0; binding->key.keycodes&&binding->key.keycodes[i]; ++i)
-                binding->previous_key.keycodes[i] = binding->key.keycodes[i];
+                for (i = 0; binding->key.keycodes[i]; ++i);
+                binding->previous_key.keycodes = g_new0 (guint, i + 1);
 
-            } else
-                qDebug ("Key binding (%s) is already in use", binding->binding_str);
+                for (i = 0; binding->key.keycodes[i]; ++i)
+                    binding->previous_key.keycodes[i] = binding->key.keycodes[i];
+            }
         }
     }
 
-    if (need_flush)
-        gdk_display_flush (gdk_display_get_default());
-    if(gdk_x11_display_error_trap_pop (gdk_display_get_default()))
-        qWarning("Grab failed for some keys, another application may already have access the them.");
+    /* all grabs above were sent in one burst, collect their errors once */
+    ShortcutRegistry::commit ();
 }
 
 /**
- * @brief keybindings_filter   键盘事件回调函数
- * @param gdk_xevent  GDK XEvent事件
- * @param event   GDK Event事件
- * @param manager 类
- * @return 未处理事件，请继续处理
+ * @brief KeybindingsManager::keymap_changed
+ * Keycodes of the bindings change with the keymap, re-parse and re-grab them
+ * 键盘布局改变后键码会变化，需要重新解析并绑定按键
  */
-GdkFilterReturn
-keybindings_filter (GdkXEvent           *gdk_xevent,
-                    GdkEvent            *event,
-                    KeybindingsManager  *manager)
+void KeybindingsManager::keymap_changed (GdkKeymap          *keymap,
+                                         KeybindingsManager *manager)
 {
-    XEvent *xevent = (XEvent *) gdk_xevent;
     GSList *li;
- 
-    if (xevent->type != KeyPress) {
-        return GDK_FILTER_CONTINUE;
-    }
 
-    for (li = manager->binding_list; li != NULL; li = li->next) {
-        Binding *binding = (Binding *) li->data;
+    binding_unregister_keys (manager);
+    for (li = manager->binding_list; li != NULL; li = li->next)
+        parse_binding ((Binding *) li->data);
+    binding_register_keys (manager);
+}
 
-        if (match_key (&binding->key, xevent)) {
-            GError  *error = NULL;
-            gboolean retval;
-            gchar  **argv = NULL;
+typedef struct {
+        GAppInfo  *app_info;
+        gchar    **argv;
+        gchar     *action;
+        gchar     *binding_str;
+} LaunchJob;
 
-            if (binding->action == NULL)
-                return GDK_FILTER_CONTINUE;
+/**
+ * @brief launch_job_run
+ * Runs on the launcher thread, only the spawn itself happens here
+ * 在启动线程中执行，这里只做进程创建
+ */
+static void
+launch_job_run (LaunchJob *job, KeybindingsManager *manager)
+{
+    gboolean retval = FALSE;
+
+    if (job->app_info)
+        retval = g_app_info_launch_uris (job->app_info, NULL, NULL, NULL);
+    else if (job->argv)
+        retval = PreforkLauncher::spawn (NULL, job->argv);
+
+    if (!retval)
+        QMetaObject::invokeMethod (manager, "launch_failed", Qt::QueuedConnection,
+                                   Q_ARG (QString, QString::fromUtf8 (job->action)),
+                                   Q_ARG (QString, QString::fromUtf8 (job->binding_str)));
+
+    if (job->app_info)
+        g_object_unref (job->app_info);
+    g_strfreev (job->argv);
+    g_free (job->action);
+    g_free (job->binding_str);
+    g_free (job);
+}
 
-            if (!g_shell_parse_argv (binding->action,
-                                     NULL, &argv,
-                                     &error)) {
-                    return GDK_FILTER_CONTINUE;
-            }
+/**
+ * @brief KeybindingsManager::binding_launch
+ * Hand the cached launch data of a binding to the launcher thread
+ * 将绑定缓存的启动信息交给启动线程
+ */
+void KeybindingsManager::binding_launch (KeybindingsManager *manager, Binding *binding)
+{
+    LaunchJob *job = g_new0 (LaunchJob, 1);
 
-            GDesktopAppInfo *info = g_desktop_app_info_new_from_filename(binding->action);
-            retval = g_app_info_launch_uris((GAppInfo *)info, NULL, NULL, NULL);
-
-            g_strfreev (argv);
-
-            /* Run failed popup
-             * 运行失败弹窗 */
-            if (!retval) {
-                QString strs = QObject::tr("Error while trying to run \"%1\";\n which is linked to the key \"%2\"").
-                                        arg(binding->action).arg(binding->binding_str);
-                QMessageBox *msgbox = new QMessageBox();
-                msgbox->setWindowTitle(QObject::tr("Shortcut message box"));
-                msgbox->setText(strs);
-                msgbox->setStandardButtons(QMessageBox::Yes);
-                msgbox->setButtonText(QMessageBox::Yes,QObject::tr("Yes"));
-                msgbox->exec();
-                delete msgbox;
-            }
-            return GDK_FILTER_REMOVE;
-        }
+    job->app_info = binding->app_info ? (GAppInfo *) g_object_ref (binding->app_info) : NULL;
+    job->argv = g_strdupv (binding->argv);
+    job->action = g_strdup (binding->action);
+    job->binding_str = g_strdup (binding->binding_str);
+
+    g_thread_pool_push (manager->launch_pool, job, NULL);
+}
+
+/**
+ * @brief KeybindingsManager::launch_failed
+ * Run failed popup, back on the GUI thread
+ * 运行失败弹窗，回到界面线程执行
+ */
+void KeybindingsManager::launch_failed (const QString &action, const QString &binding_str)
+{
+    QString strs = QObject::tr("Error while trying to run \"%1\";\n which is linked to the key \"%2\"").
+                            arg(action).arg(binding_str);
+    QMessageBox *msgbox = new QMessageBox();
+    msgbox->setWindowTitle(QObject::tr("Shortcut message box"));
+    msgbox->setText(strs);
+    msgbox->setStandardButtons(QMessageBox::Yes);
+    msgbox->setButtonText(QMessageBox::Yes,QObject::tr("Yes"));
+    msgbox->exec();
+    delete msgbox;
+}
+
+/**
+ * @brief keybindings_activate   快捷键触发回调函数
+ * @param xevent  X 按键事件
+ * @param data    触发的绑定
+ * @param user_data 类
+ * @return 未处理事件，请继续处理
+ */
+static GdkFilterReturn
+keybindings_activate (XEvent   *xevent,
+                      gpointer  data,
+                      gpointer  user_data)
+{
+    Binding *binding = (Binding *) data;
+
+    if (xevent->type != KeyPress) {
+        return GDK_FILTER_CONTINUE;
     }
-    return GDK_FILTER_CONTINUE;
+
+    if (binding->action == NULL)
+        return GDK_FILTER_CONTINUE;
+
+    /* A command line that could not be parsed is ignored */
+    if (!binding->argv && !g_str_has_suffix (binding->action, ".desktop"))
+        return GDK_FILTER_CONTINUE;
+
+    KeybindingsManager::binding_launch ((KeybindingsManager *) user_data, binding);
+    return GDK_FILTER_REMOVE;
 }
 
 /**
@@ -425,70 +547,98 @@ void KeybindingsManager::bindings_callback (DConfClient  *client,
                                             gchar        *tag,
                                             KeybindingsManager *manager)
 {
+    GHashTable     *paths;
+    GHashTableIter  iter;
+    gpointer        path;
+
     qDebug ("keybindings: received 'changed' signal from dconf");
 
-    binding_unregister_keys (manager);
-    bindings_get_entries (manager);
+    paths = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+    if (!bindings_changed_paths (prefix, changes, paths)) {
+        binding_unregister_keys (manager);
+        bindings_get_entries (manager);
+        binding_register_keys (manager);
+        g_hash_table_destroy (paths);
+        return;
+    }
+
+    /* Only re-read the bindings that changed, the others keep their grabs */
+    g_hash_table_iter_init (&iter, paths);
+    while (g_hash_table_iter_next (&iter, &path, NULL))
+        bindings_get_entry (manager, (const char *) path);
     binding_register_keys (manager);
-}
 
+    g_hash_table_destroy (paths);
+}
 
 /**
- * @brief get_screens_list  获取gdkscreen屏幕并存放链表
- * @return  返回列表
+ * @brief KeybindingsManager::bindings_changed_paths
+ * Collect the binding directories touched by a dconf change
+ * 收集 dconf 变更涉及的快捷键目录
+ * @return false if the whole keybindings directory must be reloaded
  */
-void KeybindingsManager::get_screens_list (void)
+bool KeybindingsManager::bindings_changed_paths (const gchar *prefix,
+                                                 GStrv        changes,
+                                                 GHashTable  *paths)
 {
-    GdkScreen  *screen = gdk_screen_get_default ();
-    screens->append(screen);
+    gsize dir_len = strlen (GSETTINGS_KEYBINDINGS_DIR);
+    gint  i;
+
+    if (!prefix || !changes)
+        return false;
+
+    for (i = 0; changes[i] != NULL; i++) {
+        gchar       *full = g_strconcat (prefix, changes[i], NULL);
+        const gchar *rest;
+        const gchar *slash;
+
+        if (!g_str_has_prefix (full, GSETTINGS_KEYBINDINGS_DIR)) {
+            g_free (full);
+            continue;
+        }
+
+        rest = full + dir_len;
+        slash = strchr (rest, '/');
+        if (rest[0] == '\0' || slash == NULL) {
+            /* the directory itself or a key outside any binding changed */
+            g_free (full);
+            return false;
+        }
+
+        g_hash_table_add (paths, g_strndup (full, slash - full + 1));
+        g_free (full);
+    }
+    return true;
 }
 
+
 bool KeybindingsManager::KeybindingsManagerStart()
 {
     qDebug("Keybindings Manager Start");
-    QList<GdkScreen*>::iterator l, begin, end;
     GdkDisplay  *dpy;
-    GdkScreen   *screen;
-    GdkWindow   *window;
-    Display     *xdpy;
-    Window       xwindow;
-    XWindowAttributes atts;
 
     gdk_init(NULL,NULL);
     dpy = gdk_display_get_default ();
 
-    xdpy = QX11Info::display();
-
-    screen = gdk_display_get_default_screen(dpy);
-    window  = gdk_screen_get_root_window (screen);
-    xwindow = GDK_WINDOW_XID (window);
-
-    /* Monitor keyboard events
-     * 监听键盘事件
+    /* Key events are filtered by the shared shortcut registry
+     * 按键事件由共享的快捷键注册表过滤并分发
      */
-    gdk_window_add_filter (window,
-                           (GdkFilterFunc) keybindings_filter,
-                           this);
-
+    shortcuts = ShortcutRegistry::addClient ("keybindings",
+                                             keybindings_activate,
+                                             binding_grab_failed,
+                                             this);
 
-    try {
-        /* Add KeyPressMask to the currently reportable event masks
-         * 将KeyPressMask添加到当前可报告的事件掩码
-         */
-        gdk_x11_display_error_trap_push (gdk_display_get_default());
-        XGetWindowAttributes (xdpy, xwindow, &atts);
-        XSelectInput (xdpy, xwindow, atts.your_event_mask | KeyPressMask);
-        gdk_x11_display_error_trap_pop_ignored(gdk_display_get_default());
-    } catch (int) {
-
-    }
-    screens = new QList<GdkScreen*>();
-    get_screens_list ();
+    /* One launcher thread keeps fork/exec out of the key event path */
+    launch_pool = g_thread_pool_new ((GFunc) launch_job_run, this, 1, FALSE, NULL);
+    PreforkLauncher::ref ();
 
     binding_list = NULL;
     bindings_get_entries (this);
     binding_register_keys(this);
 
+    g_signal_connect (gdk_keymap_get_for_display (dpy), "keys-changed",
+                      G_CALLBACK (keymap_changed), this);
+
     /* Link to dconf, receive a shortcut key change signal from dconf
      * 链接dconf, 从dconf收到更改快捷键信号
      */
@@ -507,19 +657,15 @@ void KeybindingsManager::KeybindingsManagerStop()
             g_object_unref (client);
             client = NULL;
     }
-    QList<GdkScreen*>::iterator l,end;
-
-    l = screens->begin();
-    GdkScreen *screen = *l;
-    gdk_window_remove_filter (gdk_screen_get_root_window (screen),
-                              (GdkFilterFunc) keybindings_filter,
-                              this);
-
+    g_signal_handlers_disconnect_by_func (gdk_keymap_get_for_display (gdk_display_get_default ()),
+                                          (gpointer) keymap_changed, this);
 
     binding_unregister_keys (this);
     bindings_clear (this);
+    ShortcutRegistry::removeClient (shortcuts);
+    shortcuts = NULL;
 
-    screens->clear();
-    delete screens;
-    screens = NULL;
+    g_thread_pool_free (launch_pool, FALSE, TRUE);
+    launch_pool = NULL;
+    PreforkLauncher::unref ();
 }
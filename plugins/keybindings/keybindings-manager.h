@@ -47,6 +47,8 @@ extern "C"{
 #include "ukui-keygrab.h"
 #include "eggaccelerators.h"
 }
+#include "ukui-shortcut-registry.h"
+#include "ukui-prefork-launcher.h"
 
 typedef struct {
         char *binding_str;
@@ -54,6 +56,9 @@ typedef struct {
         char *settings_path;
         Key   key;
         Key   previous_key;
+        GAppInfo     *app_info;     /* parsed .desktop action */
+        gchar       **argv;         /* parsed command line action */
+        GFileMonitor *monitor;      /* invalidates app_info */
 } Binding;
 
 class KeybindingsManager : public QObject
@@ -68,7 +73,6 @@ public:
     static KeybindingsManager *KeybindingsManagerNew();
     bool KeybindingsManagerStart();
     void KeybindingsManagerStop();
-    void get_screens_list();
 
 public:
     static void bindings_callback (DConfClient  *client,
@@ -77,22 +81,25 @@ public:
                                    gchar        *tag,
                                    KeybindingsManager *manager);
 
-    static bool key_already_used (KeybindingsManager *manager,Binding  *binding);
+    static void binding_release_grab (KeybindingsManager *manager, Binding *binding);
     static void binding_register_keys (KeybindingsManager *manager);
     static void binding_unregister_keys (KeybindingsManager *manager);
     static void bindings_clear(KeybindingsManager *manager);
     static void bindings_get_entries(KeybindingsManager *manager);
     static bool bindings_get_entry (KeybindingsManager *manager,const char *settings_path);
+    static bool bindings_changed_paths (const gchar *prefix, GStrv changes, GHashTable *paths);
+    static void keymap_changed (GdkKeymap *keymap, KeybindingsManager *manager);
+    static void binding_launch (KeybindingsManager *manager, Binding *binding);
 
-    friend GdkFilterReturn keybindings_filter (GdkXEvent           *gdk_xevent,
-                                               GdkEvent            *event,
-                                               KeybindingsManager  *manager);
+private Q_SLOTS:
+    void launch_failed (const QString &action, const QString &binding_str);
 
 private:
     static KeybindingsManager *mKeybinding;
     DConfClient *client;
     GSList   *binding_list;
-    QList<GdkScreen*> *screens;
+    ShortcutClient *shortcuts;
+    GThreadPool *launch_pool;   /* spawns bindings off the GUI thread */
 
 };
 
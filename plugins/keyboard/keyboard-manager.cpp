@@ -50,6 +50,8 @@ KeyboardManager::KeyboardManager(QObject * parent)
     if(mKeyXkb == nullptr)
         mKeyXkb = new KeyboardXkb;
     settings = new QGSettings(USD_KEYBOARD_SCHEMA);
+    /* capslock-state/numlock-state 在每次按键释放时写入，合并后再提交 */
+    settings->coalesce();
 }
 
 KeyboardManager::~KeyboardManager()
@@ -281,22 +283,17 @@ void apply_repeat (KeyboardManager *manager)
 
 
 
-void KeyboardManager::apply_settings (QString keys)
+/* keys 为一次批量通知中改变的所有 key，为空时表示启动时的初始化 */
+void KeyboardManager::apply_settings (QStringList keys)
 {
     /**
      * Fix by HB* system reboot but rnumlock not available;
     **/
 
-    char *key;
-    if(keys != NULL)
-        key = keys.toLatin1().data();
-    else
-        key=NULL;
-
 #ifdef HAVE_X11_EXTENSIONS_XKB_H
     bool rnumlock;
     rnumlock = settings->get(KEY_NUMLOCK_REMEMBER).toBool();
-    if (rnumlock == 0 || key == NULL) {
+    if (rnumlock == 0 || keys.isEmpty()) {
         if (have_xkb && rnumlock) {
             numlock_set_xkb_state (numlock_get_settings_state (settings));
             capslock_set_xkb_state(settings->get(KEY_CAPSLOCK_STATE).toBool());
@@ -304,35 +301,47 @@ void KeyboardManager::apply_settings (QString keys)
     }
 #endif /* HAVE_X11_EXTENSIONS_XKB_H */
 
-    if (keys.compare(QString::fromLocal8Bit(KEY_CLICK)) == 0||
-        keys.compare(QString::fromLocal8Bit(KEY_CLICK_VOLUME)) == 0 ||
-        keys.compare(QString::fromLocal8Bit(KEY_BELL_PITCH)) == 0 ||
-        keys.compare(QString::fromLocal8Bit(KEY_BELL_DURATION)) == 0 ||
-        keys.compare(QString::fromLocal8Bit(KEY_BELL_MODE)) == 0) {
-                qDebug ("Bell setting '%s' changed, applying bell settings", key);
-                apply_bell (this);
+    bool bell = false;
+    bool repeat = false;
 
-    } else if (keys.compare(QString::fromLocal8Bit(KEY_NUMLOCK_REMEMBER)) == 0) {
-            qDebug ("Remember Num-Lock state '%s' changed, applying num-lock settings", key);
-            apply_numlock (this);
+    for (const QString &key : keys) {
+        if (key.compare(QString::fromLocal8Bit(KEY_CLICK)) == 0||
+            key.compare(QString::fromLocal8Bit(KEY_CLICK_VOLUME)) == 0 ||
+            key.compare(QString::fromLocal8Bit(KEY_BELL_PITCH)) == 0 ||
+            key.compare(QString::fromLocal8Bit(KEY_BELL_DURATION)) == 0 ||
+            key.compare(QString::fromLocal8Bit(KEY_BELL_MODE)) == 0) {
+                bell = true;
 
-    } else if (keys.compare(QString::fromLocal8Bit(KEY_NUMLOCK_STATE)) == 0) {
-            qDebug ("Num-Lock state '%s' changed, will apply at next startup", key);
+        } else if (key.compare(QString::fromLocal8Bit(KEY_NUMLOCK_REMEMBER)) == 0) {
+                qDebug ("Remember Num-Lock state '%s' changed, applying num-lock settings", key.toLatin1().data());
+                apply_numlock (this);
 
-    } else if (keys.compare(QString::fromLocal8Bit(KEY_REPEAT)) == 0 ||
-               keys.compare(QString::fromLocal8Bit(KEY_RATE)) == 0 ||
-               keys.compare(QString::fromLocal8Bit(KEY_DELAY)) == 0) {
-            qDebug ("Key repeat setting '%s' changed, applying key repeat settings", key);
-            apply_repeat (this);
+        } else if (key.compare(QString::fromLocal8Bit(KEY_NUMLOCK_STATE)) == 0) {
+                qDebug ("Num-Lock state '%s' changed, will apply at next startup", key.toLatin1().data());
 
-    } else {
-            qWarning ("Unhandled settings change, key '%s'", key);
+        } else if (key.compare(QString::fromLocal8Bit(KEY_REPEAT)) == 0 ||
+                   key.compare(QString::fromLocal8Bit(KEY_RATE)) == 0 ||
+                   key.compare(QString::fromLocal8Bit(KEY_DELAY)) == 0) {
+                repeat = true;
+
+        } else {
+                qWarning ("Unhandled settings change, key '%s'", key.toLatin1().data());
+        }
+    }
+
+    if (bell) {
+        qDebug ("Bell settings changed, applying bell settings");
+        apply_bell (this);
+    }
+    if (repeat) {
+        qDebug ("Key repeat settings changed, applying key repeat settings");
+        apply_repeat (this);
     }
 }
 
 void KeyboardManager::usd_keyboard_manager_apply_settings (KeyboardManager *manager)
 {
-        apply_settings(NULL);
+        apply_settings(QStringList());
 }
 
 void KeyboardManager::XkbEventsFilter(int keyCode)
@@ -391,8 +400,8 @@ void KeyboardManager::start_keyboard_idle_cb ()
     /* apply current settings before we install the callback */
     usd_keyboard_manager_apply_settings (this);
 
-    connect(settings,SIGNAL(changed(QString)),this,
-            SLOT(apply_settings(QString)));
+    connect(settings,SIGNAL(changedBatch(QStringList)),this,
+            SLOT(apply_settings(QStringList)));
 
 #ifdef HAVE_X11_EXTENSIONS_XKB_H
     numlock_install_xkb_callback();
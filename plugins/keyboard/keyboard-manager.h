@@ -62,7 +62,7 @@ public:
 
 public Q_SLOTS:
     void start_keyboard_idle_cb ();
-    void apply_settings  (QString);
+    void apply_settings  (QStringList);
     void XkbEventsFilter(int keyCode);
 
 private:
@@ -19,6 +19,8 @@
 #include "devicewindow.h"
 #include "ui_devicewindow.h"
 #include <QDebug>
+#include <QPainter>
+#include <QSvgRenderer>
 
 const QString ICONDIR = "/usr/share/icons/ukui-icon-theme-default/scalable";
 const QString allIconName[] = {
@@ -48,9 +50,10 @@ DeviceWindow::~DeviceWindow()
 void DeviceWindow::initWindowInfo()
 {
     int num,screenWidth,screenHeight;
+    int svgWidth,svgHeight,svgX,svgY;
     QScreen* currentScreen;
 
-    mSvg = new QSvgWidget(this);
+    mSvg = new QLabel(this);
     mTimer = new QTimer();
     connect(mTimer,SIGNAL(timeout()),this,SLOT(timeoutHandle()));
 
@@ -65,6 +68,39 @@ void DeviceWindow::initWindowInfo()
     setPalette(QPalette(Qt::black));//设置窗口背景色
     setAutoFillBackground(true);
     move((screenWidth-width())/2 , (screenHeight-height())/2);
+
+    //the window has a fixed size, place the icon once
+    ensureSvgInfo(&svgWidth,&svgHeight,&svgX,&svgY);
+    mSvg->setGeometry(svgX,svgY,svgWidth,svgHeight);
+    mIconRatio = 0;
+
+    //render every icon now so showing the window parses no svg
+    for(int i = 0; !allIconName[i].isNull(); ++i)
+        iconPixmap(allIconName[i]);
+}
+
+QPixmap DeviceWindow::iconPixmap(const QString &path)
+{
+    if(devicePixelRatioF() != mIconRatio){
+        mIconCache.clear();
+        mIconRatio = devicePixelRatioF();
+        mShownIcon.clear();
+    }
+
+    QHash<QString,QPixmap>::const_iterator it = mIconCache.constFind(path);
+    if(it != mIconCache.constEnd())
+        return it.value();
+
+    QPixmap pixmap(mSvg->size() * mIconRatio);
+    pixmap.fill(Qt::transparent);
+    QSvgRenderer renderer(path);
+    QPainter painter(&pixmap);
+    renderer.render(&painter);
+    painter.end();
+    pixmap.setDevicePixelRatio(mIconRatio);
+
+    mIconCache.insert(path, pixmap);
+    return pixmap;
 }
 
 void DeviceWindow::setAction(const QString icon)
@@ -81,14 +117,14 @@ void DeviceWindow::setAction(const QString icon)
 
 void DeviceWindow::dialogShow()
 {
-    int svgWidth,svgHeight;
-    int svgX,svgY;
+    QPixmap icon = iconPixmap(mIconName);
 
-    ensureSvgInfo(&svgWidth,&svgHeight,&svgX,&svgY);
-
-    mSvg->setGeometry(svgX,svgY,svgWidth,svgHeight);
-    mSvg->load(mIconName);
-    show();
+    if(mIconName != mShownIcon){
+        mSvg->setPixmap(icon);
+        mShownIcon = mIconName;
+    }
+    if(!isVisible())
+        show();
     mTimer->start(2000);
 }
 
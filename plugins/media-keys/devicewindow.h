@@ -21,7 +21,9 @@
 
 #include <QWidget>
 #include <QString>
-#include <QSvgWidget>
+#include <QLabel>
+#include <QHash>
+#include <QPixmap>
 #include <QApplication>
 #include <QX11Info>
 #include <QScreen>
@@ -44,6 +46,7 @@ public:
 
 private:
     void ensureSvgInfo(int*,int*,int*,int*);
+    QPixmap iconPixmap(const QString&);
 
 private Q_SLOTS:
     void timeoutHandle();
@@ -51,8 +54,11 @@ private Q_SLOTS:
 private:
     Ui::DeviceWindow *ui;
     QString          mIconName;
-    QSvgWidget       *mSvg;
+    QString          mShownIcon;
+    QLabel           *mSvg;
     QTimer           *mTimer;
+    QHash<QString,QPixmap> mIconCache;    //svg icons rendered at the window scale
+    qreal            mIconRatio;
 };
 
 #endif // DEVICEWINDOW_H
@@ -16,16 +16,41 @@
  * You should have received a copy of the GNU General Public License
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
-#include <QTime>
 #include <QDebug>
 #include "mediakey-manager.h"
 #include "eggaccelerators.h"
+#include "ukui-settings-pool.h"
 
 MediaKeysManager* MediaKeysManager::mManager = nullptr;
 
 const int VOLUMESTEP = 6;
+const int VOLUME_FRAME_INTERVAL = 16;   //apply repeated volume keys once per frame
+const int PATH_RESCAN_DELAY = 500;     //wait for package installs to settle
 #define midValue(x,low,high) (((x) > (high)) ? (high): (((x) < (low)) ? (low) : (x)))
 
+/* every program executeCommand() may start, resolved once in resolveBinaries()
+ * executeCommand()可能启动的程序，在resolveBinaries()中统一查找 */
+static const char *launchTools[] = {
+    "ukui-session-tools",
+    "peony",
+    "beagle-search",
+    "tracker-search-tool",
+    "mate-search-tool",
+    "ukui-screensaver-command",
+    "xscreensaver-command",
+    "ukui-control-center",
+    "ukui-window-switch",
+    "galculator",
+    "mate-calc",
+    "gnome-calculator",
+    "mate-terminal",
+    "kylin-screenshot",
+    "ukui-sidebar",
+    "ukui-system-monitor",
+    "nm-connection-editor",
+    NULL
+};
+
 MediaKeysManager::MediaKeysManager(QObject* parent):QObject(parent)
 {
     gdk_init(NULL,NULL);
@@ -51,7 +76,6 @@ MediaKeysManager* MediaKeysManager::mediaKeysNew()
 bool MediaKeysManager::mediaKeysStart(GError*)
 {
     mate_mixer_init();
-    QList<GdkScreen*>::iterator l,begin,end;
 
     syslog(LOG_DEBUG,"Starting mediakeys manager!");
 
@@ -63,6 +87,21 @@ bool MediaKeysManager::mediaKeysStart(GError*)
     mExecCmd = new QProcess();
     mManager->mStream = NULL;
     mManager->mControl = NULL;
+    mVolumeMin = mVolumeMax = 0;
+    mPendingVolumeKeys.clear();
+    mVolumeTimer = new QTimer(this);
+    mVolumeTimer->setSingleShot(true);
+    mVolumeTimer->setInterval(VOLUME_FRAME_INTERVAL);
+    connect(mVolumeTimer,SIGNAL(timeout()),this,SLOT(applyPendingVolume()));
+    updateVolumeStep();
+
+    mPathWatcher = new QFileSystemWatcher(this);
+    mPathTimer = new QTimer(this);
+    mPathTimer->setSingleShot(true);
+    mPathTimer->setInterval(PATH_RESCAN_DELAY);
+    connect(mPathWatcher,SIGNAL(directoryChanged(QString)),mPathTimer,SLOT(start()));
+    connect(mPathTimer,SIGNAL(timeout()),this,SLOT(resolveBinaries()));
+    resolveBinaries();
 
     mVolumeWindow->initWindowInfo();
     mDeviceWindow->initWindowInfo();
@@ -77,29 +116,33 @@ bool MediaKeysManager::mediaKeysStart(GError*)
         mate_mixer_context_open(mContext);
     }
 
+    PreforkLauncher::ref();
     initScreens();
+    //key events are filtered by the shared shortcut registry
+    mShortcuts = ShortcutRegistry::addClient("media-keys",acmeActivate,onGrabFailed,NULL);
     initKbd();
 
-    l = begin = mScreenList->begin();
-    end = mScreenList->end();
-    for(; l != end; ++l){
-        //syslog(LOG_DEBUG,"adding key filter for screen: %d",gdk_screen_get_number(*l));
-        gdk_window_add_filter(gdk_screen_get_root_window(*l),
-                                 (GdkFilterFunc)acmeFilterEvents,
-                                 NULL);
-    }
-
     return true;
 }
 
 void MediaKeysManager::mediaKeysStop()
 {
-    QList<GdkScreen*>::iterator l,end;
-    bool needFlush;
-    int i;
-
     syslog(LOG_DEBUG,"Stooping media keys manager!");
 
+    g_signal_handlers_disconnect_by_func(gdk_keymap_get_for_display(gdk_display_get_default()),
+                                         (gpointer)onKeymapChanged,NULL);
+    ungrabKeys();
+    ShortcutRegistry::removeClient(mShortcuts);
+    mShortcuts = NULL;
+    PreforkLauncher::unref();
+
+    delete mVolumeTimer;
+    mVolumeTimer = nullptr;
+    delete mPathTimer;
+    mPathTimer = nullptr;
+    delete mPathWatcher;
+    mPathWatcher = nullptr;
+    clearCommandCache();
     delete mSettings;
     mSettings = nullptr;
     delete mExecCmd;
@@ -109,33 +152,10 @@ void MediaKeysManager::mediaKeysStop()
     delete mDeviceWindow;
     mDeviceWindow = nullptr;
 
-    l = mScreenList->begin();
-    end = mScreenList->end();
-    for(; l != end; ++l)
-        gdk_window_remove_filter(gdk_screen_get_root_window(*l),
-                                 (GdkFilterFunc)acmeFilterEvents,
-                                 NULL);
     mScreenList->clear();
     delete  mScreenList;
     mScreenList = nullptr;
 
-    needFlush = false;
-    gdk_x11_display_error_trap_push(gdk_display_get_default());
-    for(i = 0; i < HANDLED_KEYS; ++i){
-        if(keys[i].key){
-            needFlush = true;
-            grab_key_unsafe(keys[i].key,false,mScreenList);
-            g_free(keys[i].key->keycodes);
-            g_free(keys[i].key);
-            keys[i].key = NULL;
-        }
-    }
-
-    if(needFlush)
-        gdk_display_flush(gdk_display_get_default());
-
-    gdk_x11_display_error_trap_pop_ignored(gdk_display_get_default());
-
     g_clear_object(&mStream);
     g_clear_object(&mControl);
     g_clear_object(&mContext);
@@ -159,40 +179,36 @@ void MediaKeysManager::initScreens()
 }
 
 GdkFilterReturn
-MediaKeysManager::acmeFilterEvents(GdkXEvent* xevent,GdkEvent* event,void* data)
+MediaKeysManager::acmeActivate(XEvent* xev,gpointer data,gpointer userData)
 {
-    XEvent    *xev = (XEvent *) xevent;
-    XAnyEvent *xany = (XAnyEvent *) xevent;
-    int       i;
-
-    /* verify we have a key event */
-    if (xev->type != KeyPress && xev->type != KeyRelease)
-        return GDK_FILTER_CONTINUE;
+    XAnyEvent *xany = (XAnyEvent *) xev;
+    int       i = GPOINTER_TO_INT(data);
 
-    for (i = 0; i < HANDLED_KEYS; i++) {
-        if (match_key (keys[i].key, xev)) {
-            switch (keys[i].key_type) {
-            case VOLUME_DOWN_KEY:
-            case VOLUME_UP_KEY:
-                /* auto-repeatable keys */
-                if (xev->type != KeyPress)
-                    return GDK_FILTER_CONTINUE;
-                break;
-            default:
-                if (xev->type != KeyRelease)
-                    return GDK_FILTER_CONTINUE;
-            }
+    switch (keys[i].key_type) {
+    case VOLUME_DOWN_KEY:
+    case VOLUME_UP_KEY:
+        /* auto-repeatable keys */
+        if (xev->type != KeyPress)
+            return GDK_FILTER_CONTINUE;
+        break;
+    default:
+        if (xev->type != KeyRelease)
+            return GDK_FILTER_CONTINUE;
+    }
 
-            mManager->mCurrentScreen = mManager->acmeGetScreenFromEvent(xany);
+    mManager->mCurrentScreen = mManager->acmeGetScreenFromEvent(xany);
 
-            if (mManager->doAction(keys[i].key_type) == false)
-                return GDK_FILTER_REMOVE;
-            else
-                return GDK_FILTER_CONTINUE;
-        }
-    }
+    if (mManager->doAction(keys[i].key_type) == false)
+        return GDK_FILTER_REMOVE;
+    else
+        return GDK_FILTER_CONTINUE;
+}
 
-    return GDK_FILTER_CONTINUE;
+/* keycodes of the grabbed keys change with the keymap, parse and grab them again */
+void MediaKeysManager::onKeymapChanged(GdkKeymap* keymap,void* data)
+{
+    mManager->ungrabKeys();
+    mManager->grabKeys();
 }
 
 void MediaKeysManager::onContextStateNotify(MateMixerContext* context,GParamSpec* pspec,void* data)
@@ -241,8 +257,11 @@ void MediaKeysManager::updateDefaultOutput()
                !(flags & MATE_MIXER_STREAM_CONTROL_VOLUME_WRITABLE))
                    return;
 
-           mManager->mStream = stream;
-           mManager->mControl = control;
+           mManager->mStream = (MateMixerStream *) g_object_ref (stream);
+           mManager->mControl = (MateMixerStreamControl *) g_object_ref (control);
+           //the range only changes with the control, read it once here
+           mManager->mVolumeMin = mate_mixer_stream_control_get_min_volume (control);
+           mManager->mVolumeMax = mate_mixer_stream_control_get_normal_volume (control);
            syslog (LOG_DEBUG,"Default output stream updated to %s",
                     mate_mixer_stream_get_name (stream));
    } else
@@ -401,11 +420,24 @@ bool isValidShortcut (const QString& string)
 
 void MediaKeysManager::initKbd()
 {
-    int i;
-    bool needFlush = false;
-
-    gdk_x11_display_error_trap_push(gdk_display_get_default());
     connect(mSettings,SIGNAL(changed(const QString&)),this,SLOT(updateKbdCallback(const QString&)));
+    g_signal_connect(gdk_keymap_get_for_display(gdk_display_get_default()),"keys-changed",
+                     G_CALLBACK(onKeymapChanged),NULL);
+
+    grabKeys();
+}
+
+void MediaKeysManager::onGrabFailed(const char *accel,gpointer data,gpointer userData)
+{
+    int i = GPOINTER_TO_INT(data);
+
+    syslog(LOG_WARNING,"Grab failed for key '%s', another application may already have access to it.",
+           keys[i].settings_key ? keys[i].settings_key : keys[i].hard_coded);
+}
+
+void MediaKeysManager::grabKeys()
+{
+    int i;
 
     for(i = 0; i < HANDLED_KEYS; ++i){
         QString tmp,schmeasKey;
@@ -433,27 +465,42 @@ void MediaKeysManager::initKbd()
             continue;
         }
 
-        tmp.clear();
         keys[i].key = key;
-        needFlush = true;
-        grab_key_unsafe(key,true,mScreenList);
+        ShortcutRegistry::add(mShortcuts,tmp.toLatin1().data(),key,GINT_TO_POINTER(i));
+        tmp.clear();
+    }
+
+    /* all keys were grabbed in one burst, check the errors once */
+    ShortcutRegistry::commit();
+}
+
+void MediaKeysManager::ungrabKeys()
+{
+    int i;
+
+    for(i = 0; i < HANDLED_KEYS; ++i){
+        if(keys[i].key){
+            ShortcutRegistry::remove(mShortcuts,GINT_TO_POINTER(i));
+            g_free(keys[i].key->keycodes);
+            g_free(keys[i].key);
+            keys[i].key = NULL;
+        }
     }
 
-    if(needFlush)
-        gdk_display_flush(gdk_display_get_default());
-    if(gdk_x11_display_error_trap_pop(gdk_display_get_default()))
-        syslog(LOG_WARNING,"Grab failed for some keys,another application may already have access the them.");
+    ShortcutRegistry::commit();
 }
 
 void MediaKeysManager::updateKbdCallback(const QString &key)
 {
     int i;
-    bool needFlush = true;
 
     if(key.isNull())
         return;
 
-    gdk_x11_display_error_trap_push (gdk_display_get_default());
+    if(key == "volume-step"){
+        updateVolumeStep();
+        return;
+    }
 
     /* Find the key that was modified */
     for (i = 0; i < HANDLED_KEYS; i++) {
@@ -462,8 +509,8 @@ void MediaKeysManager::updateKbdCallback(const QString &key)
             Key  *key;
 
             if (NULL != keys[i].key) {
-                needFlush = true;
-                grab_key_unsafe (keys[i].key, false, mScreenList);
+                ShortcutRegistry::remove (mShortcuts, GINT_TO_POINTER(i));
+                g_free (keys[i].key->keycodes);
             }
 
             g_free (keys[i].key);
@@ -490,8 +537,7 @@ void MediaKeysManager::updateKbdCallback(const QString &key)
                 break;
             }
 
-            needFlush = true;
-            grab_key_unsafe (key, true, mScreenList);
+            ShortcutRegistry::add (mShortcuts, tmp.toLatin1().data(), key, GINT_TO_POINTER(i));
             keys[i].key = key;
 
             tmp.clear();
@@ -499,10 +545,7 @@ void MediaKeysManager::updateKbdCallback(const QString &key)
         }
     }
 
-    if (needFlush)
-        gdk_display_flush (gdk_display_get_default());
-    if (gdk_x11_display_error_trap_pop (gdk_display_get_default()))
-        syslog(LOG_WARNING,"Grab failed for some keys, another application may already have access the them.");
+    ShortcutRegistry::commit ();
 }
 
 void MediaKeysManager::doTouchpadAction()
@@ -510,65 +553,91 @@ void MediaKeysManager::doTouchpadAction()
     QGSettings *touchpadSettings;
     bool touchpadState;
 
-    touchpadSettings = new QGSettings("org.ukui.peripherals-touchpad");
+    touchpadSettings = SettingsPool::ref("org.ukui.peripherals-touchpad");
     touchpadState = touchpadSettings->get("touchpad-enabled").toBool();
     if(FALSE == touchpad_is_present()){
         mDeviceWindow->setAction("touchpad-disabled");
+        SettingsPool::unref(touchpadSettings);
         return;
     }
     mDeviceWindow->setAction(!touchpadState ? "touchpad-enabled" : "touchpad-disabled");
     mDeviceWindow->dialogShow();
 
     touchpadSettings->set("touchpad-enabled",!touchpadState);
-    delete touchpadSettings;
+    SettingsPool::unref(touchpadSettings);
 }
 
+void MediaKeysManager::updateVolumeStep()
+{
+    mVolumeStep = mSettings->get("volume-step").toInt();
+    if(mVolumeStep <= 0 || mVolumeStep > 100)
+        mVolumeStep = VOLUMESTEP;
+}
+
+/* Auto-repeated volume keys are only queued here, applyPendingVolume()
+ * sets the mixer and updates the OSD once per frame
+ * 自动重复的音量键在这里按顺序排队，每帧由 applyPendingVolume() 统一设置一次 */
 void MediaKeysManager::doSoundAction(int keyType)
 {
-    bool muted,mutedLast,soundChanged;  //是否静音，上一次值记录，是否改变
+    if(NULL == mControl)
+        return;
+
+    mPendingVolumeKeys.append(keyType);
+
+    if(!mVolumeTimer->isActive())
+        mVolumeTimer->start();
+}
+
+void MediaKeysManager::applyPendingVolume()
+{
+    bool muted,mutedLast,soundChanged = false;  //是否静音，上一次值记录，是否改变
     int volume,volumeMin,volumeMax;    //当前音量值，最小音量值，最大音量值
     uint volumeStep,volumeLast;         //音量步长，上一次音量值
+    QVector<int> pendingKeys;
+
+    pendingKeys.swap(mPendingVolumeKeys);
 
     if(NULL == mControl)
         return;
 
-    volumeMin = mate_mixer_stream_control_get_min_volume(mControl);
-    volumeMax = mate_mixer_stream_control_get_normal_volume(mControl);
-    volumeStep = mSettings->get("volume-step").toInt();
-    if(volumeStep <= 0 || volumeStep > 100)
-        volumeStep = VOLUMESTEP;
+    volumeMin = mVolumeMin;
+    volumeMax = mVolumeMax;
+    volumeStep = mVolumeStep;
 
     volume = volumeLast = mate_mixer_stream_control_get_volume(mControl);
     muted = mutedLast = mate_mixer_stream_control_get_mute(mControl);
 
-    switch(keyType){
-    case MUTE_KEY:
-        if(volume == volumeMin)
-            muted = true;
-        else
-            muted = !muted;
-        break;
-    case VOLUME_DOWN_KEY:
-        if(volume <= (volumeMin + volumeStep)){
-            volume = volumeMin;
-            muted = true;
-        }else{
-            volume -= volumeStep * 400;
-            muted = false;
-        }
-        if(volume < 300){
-            volume = volumeMin;
-            muted = true;
+    /* replay the keys in arrival order so the result matches single presses */
+    for(int keyType : pendingKeys){
+        switch(keyType){
+        case MUTE_KEY:
+            if(volume == volumeMin)
+                muted = true;
+            else
+                muted = !muted;
+            break;
+        case VOLUME_DOWN_KEY:
+            if(volume <= (int)(volumeMin + volumeStep)){
+                volume = volumeMin;
+                muted = true;
+            }else{
+                volume -= volumeStep * 400;
+                muted = false;
+            }
+            if(volume < 300){
+                volume = volumeMin;
+                muted = true;
+            }
+            break;
+        case VOLUME_UP_KEY:
+            if(muted){
+                muted = false;
+                if(volume <= (int)(volumeMin + volumeStep))
+                    volume = volumeMin + volumeStep * 400;
+            }else
+                volume = midValue(volume + (int)volumeStep * 400, volumeMin, volumeMax);
+            break;
         }
-        break;
-    case VOLUME_UP_KEY:
-        if(muted){
-            muted = false;
-            if(volume <= (volumeMin + volumeStep))
-                volume = volumeMin + volumeStep * 400;
-        }else
-            volume = midValue(volume + volumeStep * 400, volumeMin, volumeMax);
-        break;
     }
 
     if(muted != mutedLast){
@@ -577,7 +646,7 @@ void MediaKeysManager::doSoundAction(int keyType)
         else
             muted = mutedLast;
     }
-    if(mate_mixer_stream_control_get_volume(mControl) != volume){
+    if((int)volumeLast != volume){
         if(mate_mixer_stream_control_set_volume(mControl,volume))
             soundChanged = true;
         else
@@ -595,70 +664,80 @@ void MediaKeysManager::updateDialogForVolume(uint volume,bool muted,bool soundCh
     //ToDo...
 }
 
-void processAbstractPath(QString& process)
+/**
+ * @brief MediaKeysManager::resolveBinaries
+ *        look up every program of launchTools in PATH, called at start and
+ *        whenever one of the PATH directories changes
+ *        在PATH中查找launchTools中的程序，启动时及PATH目录变化时调用，
+ *        按键时不再访问文件系统
+ */
+void MediaKeysManager::resolveBinaries()
 {
-    QString tmpPath;
-    QFileInfo fileInfo;
+    QStringList dirs;
+    QStringList watched;
 
-    tmpPath = "/usr/bin/" + process;
-    fileInfo.setFile(tmpPath);
-    if(fileInfo.exists()){
-        process = tmpPath;
-        return;
-    }
+    dirs = QString::fromLocal8Bit(qgetenv("PATH")).split(':',QString::SkipEmptyParts);
+    if(dirs.isEmpty())
+        dirs << "/usr/local/bin" << "/usr/bin" << "/bin";
 
-    tmpPath.clear();
-    tmpPath = "/usr/sbin/" + process;
-    fileInfo.setFile(tmpPath);
-    if(fileInfo.exists()){
-        process = tmpPath;
-        return;
+    mBinaryPaths.clear();
+    for(int i = 0; launchTools[i]; ++i){
+        QString path;
+
+        for(const QString& dir : dirs){
+            QFileInfo fileInfo(dir + "/" + launchTools[i]);
+            if(fileInfo.isFile() && fileInfo.isExecutable()){
+                path = fileInfo.absoluteFilePath();
+                break;
+            }
+        }
+        mBinaryPaths.insert(launchTools[i],path);
     }
 
-    process = "";
+    watched = mPathWatcher->directories();
+    for(const QString& dir : dirs){
+        if(!watched.contains(dir) && QFileInfo(dir).isDir())
+            mPathWatcher->addPath(dir);
+    }
 }
-bool binaryFileExists(const QString& binary)
-{
-    QString tmpPath;
-    QFileInfo fileInfo;
 
-    tmpPath = "/usr/bin/" + binary;
-    fileInfo.setFile(tmpPath);
-    if(fileInfo.exists())
-        return true;
+bool MediaKeysManager::binaryFileExists(const QString& binary)
+{
+    return !mBinaryPaths.value(binary).isEmpty();
+}
 
-    tmpPath.clear();
-    tmpPath = "/usr/sbin/" + binary;
-    fileInfo.setFile(tmpPath);
-    if(fileInfo.exists())
-        return true;
+void MediaKeysManager::clearCommandCache()
+{
+    QHash<QString,char**>::iterator it;
 
-    return false;
+    for(it = mCommandArgv.begin(); it != mCommandArgv.end(); ++it)
+        g_strfreev(it.value());
+    mCommandArgv.clear();
+    mBinaryPaths.clear();
 }
 
 void MediaKeysManager::executeCommand(const QString& command,const QString& paramter){
-    QString cmd = command + paramter;
-    char   **argv;
-    int     argc;
-    bool    retval;
-
-    //processAbstractPath(cmd);
-    if(!cmd.isEmpty()){
-        if (g_shell_parse_argv (cmd.toLatin1().data(), &argc, &argv, NULL)) {
-            retval = g_spawn_async (g_get_home_dir (),
-                                    argv,
-                                    NULL,
-                                    G_SPAWN_SEARCH_PATH,
-                                    NULL,
-                                    NULL,
-                                    NULL,
-                                    NULL);
-            g_strfreev (argv);
+    QString    cmd = command + paramter;
+    QByteArray path;
+    char     **argv;
+    int        argc;
+
+    //programs in launchTools have been resolved already, others fall back to a PATH search
+    if(mBinaryPaths.contains(command)){
+        path = mBinaryPaths.value(command).toLocal8Bit();
+        if(path.isEmpty()){
+            syslog(LOG_DEBUG,"%s cannot found at system path!",command.toLatin1().data());
+            return;
         }
-        //mExecCmd->execute(cmd + paramter);//mExecCmd->start(cmd + paramter);
     }
-    else
-        syslog(LOG_DEBUG,"%s cannot found at system path!",command.toLatin1().data());
+
+    argv = mCommandArgv.value(cmd);
+    if(!argv){
+        if(!g_shell_parse_argv(cmd.toLocal8Bit().data(),&argc,&argv,NULL))
+            return;
+        mCommandArgv.insert(cmd,argv);
+    }
+    PreforkLauncher::spawn(g_get_home_dir(),argv,path.isEmpty() ? NULL : path.constData());
 }
 
 void MediaKeysManager::doShutdownAction()
@@ -748,11 +827,11 @@ void MediaKeysManager::doToggleAccessibilityKey(const QString key)
     QGSettings* toggleSettings;
     bool state;
 
-    toggleSettings = new QGSettings("org.gnome.desktop.a11y.applications");
+    toggleSettings = SettingsPool::ref("org.gnome.desktop.a11y.applications");
     state = toggleSettings->get(key).toBool();
     toggleSettings->set(key,!state);
 
-    delete toggleSettings;
+    SettingsPool::unref(toggleSettings);
 }
 
 void MediaKeysManager::doMagnifierAction()
@@ -823,7 +902,7 @@ void MediaKeysManager::doUrlAction(const QString scheme)
 void MediaKeysManager::doMultiMediaPlayerAction(const QString operation)
 {
     if(!mediaPlayers.isEmpty())
-        Q_EMIT MediaPlayerKeyPressed(mediaPlayers.first()->application,operation);
+        Q_EMIT MediaPlayerKeyPressed(mediaPlayers.first(),operation);
 }
 
 
@@ -834,30 +913,14 @@ void MediaKeysManager::doMultiMediaPlayerAction(const QString operation)
  * @param app
  *        app=="UsdMpris" is true according to the open source.
  *        按照开源的写法，这个变量的值为"UsdMpris"
- * @param time
  */
 void MediaKeysManager::GrabMediaPlayerKeys(QString app)
 {
-    QTime currentTime;
-    uint curTime = 0;       //current time(s) 当前时间(秒)
-    bool containApp;
-
-
-    currentTime = QTime::currentTime();
-    curTime = 60*currentTime.minute() + currentTime.second() + currentTime.msec()/1000;
-
-    //whether @app is inclued in @mediaPlayers  @mediaPlayers中是否包含@app
-    containApp = findMediaPlayerByApplication(app);
-
-    if(true == containApp)
-        removeMediaPlayerByApplication(app,curTime);
-
-    syslog(LOG_DEBUG,"org.ukui.SettingsDaemon.MediaKeys registering %s at %u",app.toLatin1().data(),curTime);
-    MediaPlayer* newPlayer = new MediaPlayer;
-    newPlayer->application = app;
-    newPlayer->time = curTime;
-    mediaPlayers.insert(findMediaPlayerByTime(newPlayer),newPlayer);
+    syslog(LOG_DEBUG,"org.ukui.SettingsDaemon.MediaKeys registering %s",app.toLatin1().data());
 
+    //the latest grab receives the keys 最近一次抓取的程序接收按键
+    mediaPlayers.removeAll(app);
+    mediaPlayers.prepend(app);
 }
 
 /**
@@ -866,85 +929,5 @@ void MediaKeysManager::GrabMediaPlayerKeys(QString app)
  */
 void MediaKeysManager::ReleaseMediaPlayerKeys(QString app)
 {
-    bool containApp;
-    QList<MediaPlayer*>::iterator item,end;
-    MediaPlayer* tmp;
-
-    item = mediaPlayers.begin();
-    end = mediaPlayers.end();
-
-    containApp = findMediaPlayerByApplication(app);
-
-    if(true == containApp){
-        for(; item != end; ++item){
-            tmp = *item;
-            //find @player successfully 在链表中成功找到该元素
-            if(tmp->application == app){
-                tmp->application.clear();
-                delete tmp;
-                mediaPlayers.removeOne(tmp);
-                break;
-            }
-        }
-    }
-}
-
-/**
- * @brief MediaKeysManager::findMediaPlayerByApplication
- * @param app   app=="UsdMpris" is true at general 一般情况下app=="UsdMpris"
- * @param player    if@app can be founded in @mediaPlayers, @player recored it's position
- *                  如果@app 存在于@mediaPlayers内，则@player 记录它的位置
- * @return return true if @app can be founded in @mediaPlayers
- */
-bool MediaKeysManager::findMediaPlayerByApplication(const QString& app)
-{
-    QList<MediaPlayer*>::iterator item,end;
-    MediaPlayer* tmp;
-
-    item = mediaPlayers.begin();
-    end = mediaPlayers.end();
-
-    for(; item != end; ++item){
-        tmp = *item;
-        //find @player successfully 在链表中成功找到该元素
-        if(tmp->application == app){
-            return true;
-        }
-    }
-
-    //can not find @player at QList<MediaPlayer*> 查找失败
-    return false;
-}
-
-/**
- * @brief MediaKeysManager::findMediaPlayerByTime determine insert location at the @mediaPlayers
- *        确定在@mediaPlayers中的插入位置
- * @param player
- * @return  return index.    返回下标
- */
-uint MediaKeysManager::findMediaPlayerByTime(MediaPlayer* player)
-{
-    if(mediaPlayers.isEmpty())
-        return 0;
-    return player->time < mediaPlayers.first()->time;
-}
-
-void MediaKeysManager::removeMediaPlayerByApplication(const QString& app,uint currentTime)
-{
-    QList<MediaPlayer*>::iterator item,end;
-    MediaPlayer* tmp;
-
-    item = mediaPlayers.begin();
-    end = mediaPlayers.end();
-
-    for(; item != end; ++item){
-        tmp = *item;
-        //find @player successfully 在链表中成功找到该元素
-        if(tmp->application == app && tmp->time < currentTime){
-            tmp->application.clear();
-            delete tmp;
-            mediaPlayers.removeOne(tmp);
-            break;
-        }
-    }
+    mediaPlayers.removeAll(app);
 }
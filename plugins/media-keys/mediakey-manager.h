@@ -28,6 +28,10 @@
 #include <QFileInfo>
 #include <QDir>
 #include <QList>
+#include <QVector>
+#include <QStringList>
+#include <QHash>
+#include <QFileSystemWatcher>
 #include <QDBusConnection>
 
 #include "volumewindow.h"
@@ -48,14 +52,9 @@ extern "C"{
 #include <X11/Xlib.h>
 #include "ukui-input-helper.h"
 }
+#include "ukui-shortcut-registry.h"
+#include "ukui-prefork-launcher.h"
 
-/** this value generate from mpris serviceRegisteredSlot(const QString&)
- *  这个值一般由mpris插件的serviceRegisteredSlot(const QString&)传递
- */
-typedef struct{
-    QString application;
-    uint time;
-}MediaPlayer;
 
 class MediaKeysManager:public QObject
 {
@@ -71,8 +70,12 @@ private:
     MediaKeysManager(QObject* parent = nullptr);
     void initScreens();
     void initKbd();
+    void grabKeys();
+    void ungrabKeys();
 
-    static GdkFilterReturn acmeFilterEvents(GdkXEvent*,GdkEvent*,void*);
+    static GdkFilterReturn acmeActivate(XEvent*,gpointer,gpointer);
+    static void onGrabFailed(const char*,gpointer,gpointer);
+    static void onKeymapChanged(GdkKeymap*,void*);
     static void onContextStateNotify(MateMixerContext*,GParamSpec*,void*);
     static void onContextDefaultOutputNotify(MateMixerContext*,GParamSpec*,void*);
     static void onContextStreamRemoved(MateMixerContext*,char*,void*);
@@ -83,8 +86,11 @@ private:
     /******************Functional class function(功能类函数)****************/
     void doTouchpadAction();
     void doSoundAction(int);
+    void updateVolumeStep();
     void updateDialogForVolume(uint,bool,bool);
     void executeCommand(const QString&,const QString&);
+    bool binaryFileExists(const QString&);
+    void clearCommandCache();
     void doShutdownAction();
     void doLogoutAction();
     void doOpenHomeDirAction();
@@ -107,11 +113,6 @@ private:
     void doSidebarAction();
     void doWindowSwitchAction();
 
-    /******************Function for DBus(DBus相关处理函数)******************************/
-    bool findMediaPlayerByApplication(const QString&);
-    uint findMediaPlayerByTime(MediaPlayer*);
-    void removeMediaPlayerByApplication(const QString&,uint);
-
 public Q_SLOTS:
     /** two dbus method, will be called in mpris plugin(mprismanager.cpp MprisManagerStart())
      *  两个dbus 方法，将会在mpris插件中被调用(mprismanager.cpp MprisManagerStart())
@@ -122,6 +123,8 @@ public Q_SLOTS:
 private Q_SLOTS:
     //void timeoutCallback();
     void updateKbdCallback(const QString&);
+    void applyPendingVolume();
+    void resolveBinaries();
 
 Q_SIGNALS:
     /** media-keys plugin will emit this signal by org.ukui.SettingsDaemon.MediaKeys
@@ -139,15 +142,25 @@ private:
     QTimer            *mTimer;
     QGSettings        *mSettings;
     QList<GdkScreen*> *mScreenList;     //GdkSCreen list
+    ShortcutClient    *mShortcuts;      //registration in the shared shortcut registry
     QProcess          *mExecCmd;
     GdkScreen         *mCurrentScreen;  //current GdkScreen
 
     MateMixerStream   *mStream;
     MateMixerContext  *mContext;
     MateMixerStreamControl  *mControl;
+    int               mVolumeMin;       //cached range of mControl
+    int               mVolumeMax;
+    uint              mVolumeStep;      //cached volume-step setting
+    QVector<int>      mPendingVolumeKeys;   //volume/mute keys not applied yet, in arrival order
+    QTimer           *mVolumeTimer;     //applies pending volume keys once per frame
+    QFileSystemWatcher *mPathWatcher;   //PATH directories, invalidates mBinaryPaths
+    QTimer           *mPathTimer;       //coalesces directory changes during package installs
+    QHash<QString,QString> mBinaryPaths;    //tool name -> absolute path, empty if not installed
+    QHash<QString,char**>  mCommandArgv;    //command line -> argv split once
     VolumeWindow      *mVolumeWindow;   //volume size window 声音大小窗口
     DeviceWindow      *mDeviceWindow;   //other widow，such as touchapad、volume 例如触摸板、磁盘卷设备
-    QList<MediaPlayer*> mediaPlayers;   //all opened media player(vlc,audacious) 已经打开的媒体播放器列表(vlc,audacious)
+    QStringList       mediaPlayers;     //applications that grabbed the media player keys, latest first 抓取了媒体按键的程序，最近的在前
 
 };
 
@@ -82,9 +82,47 @@ void VolumeWindow::initWindowInfo()
     mTimer = new QTimer();
     connect(mTimer,SIGNAL(timeout()),this,SLOT(timeoutHandle()));
 
+    mFrameTimer = new QTimer(this);
+    mFrameTimer->setSingleShot(true);
+    /* 虚拟或无头输出可能报告 0 Hz */
+    mFrameTimer->setInterval(qMax(1, qRound(1000 / qMax(1.0, currentScreen->refreshRate()))));
+    connect(mFrameTimer,SIGNAL(timeout()),this,SLOT(frameTimeout()));
+    mFramePending = false;
+
     mVolumeLevel = 0;
     mVolumeMuted = false;
+    mMinVolume = mMaxVolume = 0;
+    mIconRatio = 0;
+    mShownPercent = -1;
+    mShownBarValue = -1;
     setWidgetLayout();
+    prerenderIcons();
+}
+
+//渲染所有音量图标，按键时直接使用缓存
+void VolumeWindow::prerenderIcons()
+{
+    for(int i = 0; !allIconName[i].isNull(); ++i)
+        iconPixmap(allIconName[i]);
+}
+
+QPixmap VolumeWindow::iconPixmap(const QString &name)
+{
+    //icon theme or scale changed, render again
+    if(QIcon::themeName() != mIconTheme || devicePixelRatioF() != mIconRatio){
+        mIconCache.clear();
+        mIconTheme = QIcon::themeName();
+        mIconRatio = devicePixelRatioF();
+        mShownIcon.clear();
+    }
+
+    QHash<QString,QPixmap>::const_iterator it = mIconCache.constFind(name);
+    if(it != mIconCache.constEnd())
+        return it.value();
+
+    QPixmap pixmap = QIcon::fromTheme(name).pixmap(mBut->iconSize());
+    mIconCache.insert(name, pixmap);
+    return pixmap;
 }
 
 //上下留出10个空间,音量条与svg图片之间留出10个空间
@@ -132,16 +170,54 @@ int doubleToInt(double d)
         return I;
 }
 
+//repaint at most once per frame, the first change is shown at once
 void VolumeWindow::dialogShow()
 {
-    mLabel->clear();
-    mLabel->setNum(doubleToInt(mVolumeLevel/655.35));
-
-    mBut->setIcon(QIcon::fromTheme(mIconName));
-    show();
+    if(mFrameTimer->isActive())
+        mFramePending = true;
+    else{
+        frameUpdate();
+        mFrameTimer->start();
+    }
     mTimer->start(2000);
 }
 
+//changes made during the last frame are shown now
+void VolumeWindow::frameTimeout()
+{
+    if(!mFramePending)
+        return;
+
+    mFramePending = false;
+    frameUpdate();
+    mFrameTimer->start();
+}
+
+//only update the widgets whose content changed
+void VolumeWindow::frameUpdate()
+{
+    int percent = doubleToInt(mVolumeLevel/655.35);
+    int barValue = (mVolumeLevel-mMinVolume)/100;
+
+    if(percent != mShownPercent){
+        mLabel->setNum(percent);
+        mShownPercent = percent;
+    }
+    if(barValue != mShownBarValue){
+        mBar->setValue(barValue);
+        mShownBarValue = barValue;
+    }
+
+    QPixmap icon = iconPixmap(mIconName);
+    if(mIconName != mShownIcon){
+        mBut->setIcon(QIcon(icon));
+        mShownIcon = mIconName;
+    }
+
+    if(!isVisible())
+        show();
+}
+
 void VolumeWindow::setVolumeMuted(bool muted)
 {
     if(this->mVolumeMuted != muted)
@@ -153,8 +229,6 @@ void VolumeWindow::setVolumeLevel(int level)
     double percentage;
 
     this->mVolumeLevel = level;
-    mBar->reset();
-    mBar->setValue((mVolumeLevel-mMinVolume)/100);
     mIconName.clear();
 
     if(mVolumeMuted){
@@ -183,6 +257,7 @@ void VolumeWindow::setVolumeRange(int min, int max)
     mMaxVolume = max;
     mMinVolume = min;
     mBar->setRange(min,(max-min)/100);
+    mShownBarValue = -1;
 }
 
 void VolumeWindow::timeoutHandle()
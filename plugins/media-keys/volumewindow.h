@@ -29,6 +29,8 @@
 #include <QString>
 #include <QPushButton>
 #include <QLabel>
+#include <QHash>
+#include <QPixmap>
 
 QT_BEGIN_NAMESPACE
 namespace Ui {class VolumeWindow;}
@@ -48,8 +50,14 @@ public:
     void setVolumeLevel(int);
     void setVolumeRange(int, int);
 
+private:
+    void prerenderIcons();
+    QPixmap iconPixmap(const QString&);
+    void frameUpdate();
+
 private Q_SLOTS:
     void timeoutHandle();
+    void frameTimeout();
 
 private:
     Ui::VolumeWindow *ui;
@@ -62,8 +70,19 @@ private:
     QProgressBar *mBar;
     QPushButton  *mBut;
     QTimer       *mTimer;
+    QTimer       *mFrameTimer;      //limits repaints to the display refresh rate
+    bool         mFramePending;
     QString      mIconName;
 
+    //rendered icons for the current icon theme and scale
+    QHash<QString,QPixmap> mIconCache;
+    QString      mIconTheme;
+    qreal        mIconRatio;
+    //what the window currently shows, unchanged parts are not touched
+    QString      mShownIcon;
+    int          mShownPercent;
+    int          mShownBarValue;
+
     int mVolumeLevel;
     int mMaxVolume,mMinVolume;
     bool mVolumeMuted;
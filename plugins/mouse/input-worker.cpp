@@ -0,0 +1,1286 @@
+/* -*- Mode: C++; indent-tabs-mode: nil; tab-width: 4 -*-
+ * -*- coding: utf-8 -*-
+ *
+ * Copyright (C) 2020 KylinSoft Co., Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <string.h>
+#include <math.h>
+#include <stdlib.h>
+
+#include <QAtomicPointer>
+#include <QThread>
+#include <QTimer>
+#include <QSocketNotifier>
+#include <QCoreApplication>
+#include <QSet>
+#include <QDebug>
+
+#include <glib.h>
+#include <X11/Xatom.h>
+#include <X11/extensions/XInput.h>
+#include <X11/extensions/XIproto.h>
+#include <X11/extensions/XInput2.h>
+
+#include "input-worker.h"
+#include "xeventmonitor.h"
+#include "clib-syslog.h"
+
+/* 输入设备能力缓存，设备出现时查询一次，设备移除时释放 */
+struct InputDevice {
+    XID          id;
+    QString      name;
+    int          use;           /* IsXPointer、IsXExtensionPointer ... */
+    Display     *display;       /* 工作线程的 X 连接 */
+    XDevice     *device;        /* 设备存在期间保持打开 */
+    bool         touchpad;
+    bool         libinput;
+    bool         synaptics;
+    bool         buttons;       /* 带有按键 */
+    QSet<Atom>   props;         /* 设备支持的属性 */
+};
+
+/**
+ * Xlib 的错误处理函数是进程全局的。工作线程连接上的错误只记录错误码，
+ * 由请求之后的 XSync() 取出；其他连接上的错误交还给原来的处理函数。
+ *
+ * GDK 的 error trap 在 push 时保存全局处理函数、pop 时恢复，工作线程
+ * 在 trap 期间替换的处理函数会被丢掉。因此处理函数由界面线程在
+ * start()/stop() 中、任何 trap 之外安装和移除，工作线程只登记自己的连接
+ */
+static QAtomicPointer<Display> worker_display;
+static int                     worker_error_code;
+static XErrorHandler           previous_error_handler;
+
+static int
+worker_error_handler (Display     *display,
+                      XErrorEvent *error)
+{
+    if (display != NULL && display == worker_display.loadAcquire ()) {
+        if (worker_error_code == Success)
+            worker_error_code = error->error_code;
+        return 0;
+    }
+    return previous_error_handler ? previous_error_handler (display, error) : 0;
+}
+
+/* 只在界面线程调用 */
+static void
+worker_error_handler_install (void)
+{
+    worker_display.storeRelease (NULL);
+    previous_error_handler = XSetErrorHandler (worker_error_handler);
+}
+
+/* 只在界面线程、工作线程结束之后调用 */
+static void
+worker_error_handler_remove (void)
+{
+    XErrorHandler current;
+
+    /* 其他代码在此之后替换了处理函数时保留它的设置 */
+    current = XSetErrorHandler (previous_error_handler);
+    if (current != worker_error_handler)
+        XSetErrorHandler (current);
+    worker_display.storeRelease (NULL);
+}
+
+static void
+worker_error_trap_push (void)
+{
+    worker_error_code = Success;
+}
+
+/* 同步一次，返回期间第一个错误的错误码 */
+static int
+worker_error_trap_pop (Display *display)
+{
+    int code;
+
+    XSync (display, False);
+    code = worker_error_code;
+    worker_error_code = Success;
+    return code;
+}
+
+/* 属性名对应的 atom 在服务器生命周期内不变，只查询一次；只在工作线程中使用 */
+static Atom
+property_from_name (Display    *display,
+                    const char *property_name)
+{
+    static QHash<QByteArray, Atom> atoms;
+    Atom atom;
+
+    atom = atoms.value (property_name, None);
+    if (atom == None) {
+        atom = XInternAtom (display, property_name, True);
+        if (atom != None)
+            atoms.insert (property_name, atom);
+    }
+    return atom;
+}
+
+static bool
+device_has_property (InputDevice *dev,
+                     const char  *property_name)
+{
+    Atom prop = property_from_name (dev->display, property_name);
+
+    return prop != None && dev->props.contains (prop);
+}
+
+/**
+ * 查询一次设备能力：打开设备并列出其全部属性，
+ * 之后的设置只在缓存中判断设备类型和属性是否存在
+ */
+static InputDevice *
+input_device_new (Display     *display,
+                  XDeviceInfo *device_info)
+{
+    InputDevice *dev;
+    XDevice     *device;
+    Atom        *props;
+    int          n_props = 0;
+    int          i;
+
+    /* 只处理指针类的从设备 */
+    if (device_info->use != IsXExtensionPointer &&
+        device_info->use != IsXExtensionDevice)
+        return NULL;
+    if (g_strcmp0 ("Virtual core XTEST pointer", device_info->name) == 0)
+        return NULL;
+
+    worker_error_trap_push ();
+    device = XOpenDevice (display, device_info->id);
+    props = device ? XListDeviceProperties (display, device, &n_props) : NULL;
+    if (worker_error_trap_pop (display) || device == NULL) {
+        if (props)
+            XFree (props);
+        return NULL;
+    }
+
+    dev = new InputDevice;
+    dev->id = device_info->id;
+    dev->name = QString::fromLocal8Bit (device_info->name);
+    dev->use = device_info->use;
+    dev->display = display;
+    dev->device = device;
+    for (i = 0; i < n_props; i++)
+        dev->props.insert (props[i]);
+    if (props)
+        XFree (props);
+
+    dev->buttons = false;
+    XAnyClassInfo *class_info = device_info->inputclassinfo;
+    for (i = 0; i < device_info->num_classes; i++) {
+        if (class_info->c_class == ButtonClass &&
+            ((XButtonInfo *) class_info)->num_buttons > 0)
+            dev->buttons = true;
+        class_info = (XAnyClassInfo *) (((guchar *) class_info) + class_info->length);
+    }
+
+    dev->libinput = device_has_property (dev, "libinput Send Events Modes Available");
+    dev->synaptics = device_has_property (dev, "Synaptics Off");
+    dev->touchpad = device_info->type == property_from_name (display, XI_TOUCHPAD) &&
+                    (device_has_property (dev, "libinput Tapping Enabled") || dev->synaptics);
+
+    CT_SYSLOG (LOG_DEBUG, "MOUSE: device %lu \"%s\" %s%s%s", dev->id, device_info->name,
+               dev->touchpad ? "touchpad " : "", dev->libinput ? "libinput" : "",
+               dev->synaptics ? "synaptics" : "");
+    return dev;
+}
+
+static void
+input_device_free (InputDevice *dev)
+{
+    worker_error_trap_push ();
+    XCloseDevice (dev->display, dev->device);
+    worker_error_trap_pop (dev->display);
+    delete dev;
+}
+
+static InputDeviceSummary
+input_device_summary (InputDevice *dev)
+{
+    InputDeviceSummary summary;
+
+    summary.id = dev->id;
+    summary.name = dev->name;
+    summary.touchpad = dev->touchpad;
+    summary.synaptics = dev->synaptics;
+    summary.buttons = dev->buttons;
+    return summary;
+}
+
+InputWorker::InputWorker()
+    : QObject(nullptr),
+      mThread(nullptr),
+      mPending(0),
+      mDisplay(nullptr),
+      mOpcode(0),
+      mNotifier(nullptr),
+      mSettings(),
+      mHaveSettings(false),
+      mAreaLeft(0),
+      mAreaTop(0),
+      mTypingTimer(nullptr),
+      mTypingMonitor(false),
+      mTouchpadOff(false)
+{
+    qRegisterMetaType<InputSettings>("InputSettings");
+    qRegisterMetaType<InputDeviceSummary>("InputDeviceSummary");
+}
+
+InputWorker::~InputWorker()
+{
+    stop();
+}
+
+void InputWorker::start()
+{
+    if (mThread)
+        return;
+
+    /* 在工作线程打开连接之前安装 */
+    worker_error_handler_install ();
+
+    mThread = new QThread;
+    moveToThread(mThread);
+    mThread->start();
+    post("init");
+}
+
+void InputWorker::stop()
+{
+    if (!mThread)
+        return;
+
+    /* 排在已投递的命令之后执行 */
+    mPending.ref();
+    QMetaObject::invokeMethod(this, "shutdown", Qt::BlockingQueuedConnection);
+    mThread->quit();
+    mThread->wait();
+    delete mThread;
+    mThread = nullptr;
+
+    worker_error_handler_remove ();
+}
+
+void InputWorker::applySettings(const InputSettings &settings, uint mask)
+{
+    if (mask == 0)
+        return;
+    post("runApplySettings", Q_ARG(InputSettings, settings), Q_ARG(uint, mask));
+}
+
+bool InputWorker::isQuiesced() const
+{
+    return mPending.load() == 0;
+}
+
+/* 同一线程投递的队列调用按投递顺序执行，命令之间因此有序 */
+void InputWorker::post(const char *method, QGenericArgument arg0, QGenericArgument arg1)
+{
+    mPending.ref();
+    QMetaObject::invokeMethod(this, method, Qt::QueuedConnection, arg0, arg1);
+}
+
+void InputWorker::finishCommand()
+{
+    /* 命令执行期间收到的设备事件一并处理，再判断是否已经稳定 */
+    processEvents();
+    if (!mPending.deref())
+        Q_EMIT quiesced();
+}
+
+void InputWorker::init()
+{
+    XIEventMask    mask;
+    unsigned char  bits[XIMaskLen (XI_LASTEVENT)] = { 0 };
+    int            event, error;
+    int            major = 2, minor = 0;
+    XModifierKeymap *modmap;
+
+    mDisplay = XOpenDisplay (NULL);
+    if (mDisplay == NULL) {
+        CT_SYSLOG (LOG_WARNING, "MOUSE: unable to open display for input configuration");
+        finishCommand();
+        return;
+    }
+    if (!XQueryExtension (mDisplay, "XInputExtension", &mOpcode, &event, &error) ||
+        XIQueryVersion (mDisplay, &major, &minor) != Success) {
+        CT_SYSLOG (LOG_WARNING, "MOUSE: XInput 2 is not available");
+        XCloseDisplay (mDisplay);
+        mDisplay = nullptr;
+        finishCommand();
+        return;
+    }
+    worker_error_code = Success;
+    worker_display.storeRelease (mDisplay);
+
+    /* 先选择层级事件再列出设备，两者之间插入的设备不会遗漏 */
+    mask.deviceid = XIAllDevices;
+    mask.mask_len = sizeof (bits);
+    mask.mask = bits;
+    XISetMask (bits, XI_HierarchyChanged);
+    XISelectEvents (mDisplay, DefaultRootWindow (mDisplay), &mask, 1);
+
+    modmap = XGetModifierMapping (mDisplay);
+    if (modmap) {
+        for (int i = 0; i < 8 * modmap->max_keypermod; i++) {
+            if (modmap->modifiermap[i])
+                mModifierKeys.insert (modmap->modifiermap[i]);
+        }
+        XFreeModifiermap (modmap);
+    }
+
+    mTypingTimer = new QTimer(this);
+    mTypingTimer->setSingleShot(true);
+    connect(mTypingTimer, SIGNAL(timeout()), this, SLOT(typingIdle()));
+
+    loadDevices();
+
+    mNotifier = new QSocketNotifier(ConnectionNumber (mDisplay), QSocketNotifier::Read, this);
+    connect(mNotifier, SIGNAL(activated(int)), this, SLOT(processEvents()));
+    finishCommand();
+}
+
+void InputWorker::shutdown()
+{
+    if (mDisplay) {
+        delete mNotifier;
+        mNotifier = nullptr;
+
+        if (mTypingMonitor) {
+            disconnect(XEventMonitor::instance(), nullptr, this, nullptr);
+            mTypingMonitor = false;
+        }
+        mTypingTimer->stop();
+        if (mTouchpadOff)
+            setSynapticsOff (false);
+
+        /* 界面线程随后也会停止，不再逐个报告设备移除 */
+        Q_FOREACH (InputDevice *dev, mDevices)
+            input_device_free (dev);
+        mDevices.clear ();
+
+        worker_display.storeRelease (NULL);
+        XCloseDisplay (mDisplay);
+        mDisplay = nullptr;
+    }
+    mPending.deref();
+
+    /* 线程结束后对象由界面线程释放 */
+    moveToThread(QCoreApplication::instance()->thread());
+}
+
+void InputWorker::runApplySettings(InputSettings settings, uint mask)
+{
+    mSettings = settings;
+    mHaveSettings = true;
+
+    if (mDisplay) {
+        Q_FOREACH (InputDevice *dev, mDevices)
+            applyDevice (dev, mask);
+        if (mask & SETTING_DISABLE_W_TYPING)
+            updateTypingMonitor ();
+    }
+    finishCommand();
+}
+
+void InputWorker::processEvents()
+{
+    bool handled = false;
+
+    if (!mDisplay)
+        return;
+
+    while (XPending (mDisplay)) {
+        XEvent               ev;
+        XGenericEventCookie *cookie = &ev.xcookie;
+
+        XNextEvent (mDisplay, &ev);
+        if (cookie->type != GenericEvent || cookie->extension != mOpcode ||
+            !XGetEventData (mDisplay, cookie))
+            continue;
+
+        if (cookie->evtype == XI_HierarchyChanged) {
+            XIHierarchyEvent *hev = (XIHierarchyEvent *) cookie->data;
+
+            for (int i = 0; i < hev->num_info; i++) {
+                XIHierarchyInfo *info = &hev->info[i];
+
+                if (info->flags & (XIDeviceDisabled | XISlaveRemoved))
+                    removeDevice (info->deviceid);
+                else if (info->flags & XIDeviceEnabled)
+                    addDevice (info->deviceid);
+            }
+            handled = true;
+        }
+        XFreeEventData (mDisplay, cookie);
+    }
+
+    if (handled && mPending.load() == 0)
+        Q_EMIT quiesced();
+}
+
+void InputWorker::loadDevices()
+{
+    XDeviceInfo *device_info;
+    int          n_devices;
+    int          i;
+
+    device_info = XListInputDevices (mDisplay, &n_devices);
+    if (device_info == NULL) {
+        qWarning ("loadDevices: device_info is null");
+        return;
+    }
+    for (i = 0; i < n_devices; i++) {
+        InputDevice *dev = input_device_new (mDisplay, &device_info[i]);
+        if (dev) {
+            mDevices.insert (dev->id, dev);
+            Q_EMIT deviceAdded(input_device_summary (dev));
+        }
+    }
+    XFreeDeviceList (device_info);
+}
+
+/* 新出现的设备：只查询这一个设备的能力，并只对它应用全部设置 */
+void InputWorker::addDevice(XID id)
+{
+    XDeviceInfo *device_info;
+    InputDevice *dev = NULL;
+    int          n_devices;
+    int          i;
+
+    removeDevice (id);
+
+    device_info = XListInputDevices (mDisplay, &n_devices);
+    if (device_info == NULL)
+        return;
+    for (i = 0; i < n_devices; i++) {
+        if (device_info[i].id == id) {
+            dev = input_device_new (mDisplay, &device_info[i]);
+            break;
+        }
+    }
+    XFreeDeviceList (device_info);
+    if (dev == NULL)
+        return;
+
+    mDevices.insert (dev->id, dev);
+    if (mHaveSettings)
+        applyDevice (dev, SETTING_ALL);
+    if (dev->synaptics)
+        updateTypingMonitor ();
+    Q_EMIT deviceAdded(input_device_summary (dev));
+}
+
+void InputWorker::removeDevice(XID id)
+{
+    InputDevice *dev = mDevices.take (id);
+
+    if (dev) {
+        bool synaptics = dev->synaptics;
+
+        input_device_free (dev);
+        if (synaptics)
+            updateTypingMonitor ();
+        Q_EMIT deviceRemoved(id);
+    }
+}
+
+/* 本次应用中一个属性的当前值与期望值 */
+typedef struct {
+    Atom           prop;
+    Atom           type;
+    int            format;
+    unsigned long  nitems;
+    unsigned char *current;     /* XIGetProperty 读出的当前值 */
+    unsigned char *desired;     /* 当前值的副本，各设置函数在其上修改 */
+} PlanProperty;
+
+/**
+ * 设备属性应用计划
+ * 各设置函数只在计划中计算属性的期望值，同一属性只读取一次；
+ * 提交时只写回与当前值不同的属性，写请求连续发出、不等待应答，
+ * 由调用者在最后统一同步一次并检查错误
+ */
+struct _ApplyPlan {
+    Display     *display;
+    InputDevice *dev;
+    GPtrArray   *props;         /* PlanProperty */
+};
+
+#define PLAN_PROPERTY_LENGTH    16      /* 读取长度（4 字节为单位），足以容纳用到的所有属性 */
+
+static ApplyPlan *
+apply_plan_new (InputDevice *dev)
+{
+    ApplyPlan *plan = g_new0 (ApplyPlan, 1);
+
+    plan->display = dev->display;
+    plan->dev = dev;
+    plan->props = g_ptr_array_new ();
+    return plan;
+}
+
+/* 取得属性在计划中的条目，首次使用时读出当前值；设备没有该属性或类型不符时返回 NULL */
+static PlanProperty *
+apply_plan_get (ApplyPlan     *plan,
+                const char    *property_name,
+                Atom           type,
+                int            format,
+                unsigned long  min_items)
+{
+    PlanProperty  *item;
+    Atom           prop, act_type;
+    int            act_format;
+    unsigned long  nitems, bytes_after;
+    unsigned char *data = NULL;
+    guint          i;
+
+    prop = property_from_name (plan->display, property_name);
+    if (!prop || !type || !plan->dev->props.contains (prop))
+        return NULL;
+
+    for (i = 0; i < plan->props->len; i++) {
+        item = (PlanProperty *) g_ptr_array_index (plan->props, i);
+        if (item->prop == prop)
+            return (item->type == type && item->format == format &&
+                    item->nitems >= min_items) ? item : NULL;
+    }
+
+    if (XIGetProperty (plan->display, plan->dev->id, prop, 0, PLAN_PROPERTY_LENGTH, False,
+                       type, &act_type, &act_format, &nitems, &bytes_after, &data) != Success)
+        return NULL;
+    if (act_type != type || act_format != format || nitems < min_items) {
+        if (data)
+            XFree (data);
+        return NULL;
+    }
+
+    item = g_new0 (PlanProperty, 1);
+    item->prop = prop;
+    item->type = type;
+    item->format = format;
+    item->nitems = nitems;
+    item->current = data;
+    item->desired = (unsigned char *) g_memdup (data, nitems * format / 8);
+    g_ptr_array_add (plan->props, item);
+    return item;
+}
+
+/* 写回发生变化的属性并释放计划，返回写入的属性个数 */
+static int
+apply_plan_commit (ApplyPlan *plan)
+{
+    int   written = 0;
+    guint i;
+
+    for (i = 0; i < plan->props->len; i++) {
+        PlanProperty *item = (PlanProperty *) g_ptr_array_index (plan->props, i);
+
+        if (memcmp (item->current, item->desired, item->nitems * item->format / 8) != 0) {
+            XIChangeProperty (plan->display, plan->dev->id, item->prop, item->type,
+                              item->format, XIPropModeReplace, item->desired, item->nitems);
+            written++;
+        }
+        XFree (item->current);
+        g_free (item->desired);
+        g_free (item);
+    }
+    g_ptr_array_free (plan->props, TRUE);
+    g_free (plan);
+
+    return written;
+}
+
+static void
+property_set_bool (ApplyPlan   *plan,
+                   const char  *property_name,
+                   int          property_index,
+                   bool         enabled)
+{
+    PlanProperty *item;
+
+    item = apply_plan_get (plan, property_name, XA_INTEGER, 8, property_index + 1);
+    if (item)
+        item->desired[property_index] = enabled ? 1 : 0;
+}
+
+static void
+property_set_float (ApplyPlan   *plan,
+                    const char  *property_name,
+                    float        value)
+{
+    PlanProperty *item;
+
+    item = apply_plan_get (plan, property_name, property_from_name (plan->display, "FLOAT"), 32, 1);
+    if (item)
+        *(float *) item->desired = value;
+}
+
+/* 只对触摸板设置 */
+static void
+touchpad_set_bool (ApplyPlan   *plan,
+                   const char  *property_name,
+                   int          property_index,
+                   bool         enabled)
+{
+    if (plan->dev->touchpad)
+        property_set_bool (plan, property_name, property_index, enabled);
+}
+
+static void
+set_left_handed_libinput (ApplyPlan *plan,
+                          bool       mouse_left_handed,
+                          bool       touchpad_left_handed)
+{
+    bool want_lefthanded;
+
+    want_lefthanded = plan->dev->touchpad ? touchpad_left_handed : mouse_left_handed;
+    property_set_bool (plan, "libinput Left Handed Enabled", 0, want_lefthanded);
+}
+
+static bool
+touchpad_has_single_button (ApplyPlan *plan)
+{
+        PlanProperty *item;
+        unsigned char *data;
+
+        item = apply_plan_get (plan, "Synaptics Capabilities", XA_INTEGER, 8, 3);
+        if (!item)
+                return false;
+
+        data = item->current;
+        return (data[0] == 1 && data[1] == 0 && data[2] == 0);
+}
+
+static void
+set_tap_to_click_synaptics (ApplyPlan   *plan,
+                            bool         state,
+                            bool         left_handed,
+                            int          one_finger_tap,
+                            int          two_finger_tap,
+                            int          three_finger_tap)
+{
+    PlanProperty *item;
+    unsigned char *data;
+
+    if (!plan->dev->touchpad)
+            return;
+    item = apply_plan_get (plan, "Synaptics Tap Action", XA_INTEGER, 8, 7);
+    if (!item)
+            return;
+
+    if (one_finger_tap > 3 || one_finger_tap < 1)
+            one_finger_tap = 1;
+    if (two_finger_tap > 3 || two_finger_tap < 1)
+            two_finger_tap = 3;
+    if (three_finger_tap > 3 || three_finger_tap < 1)
+            three_finger_tap = 2;
+
+    /* Set RLM mapping for 1/2/3 fingers*/
+    data = item->desired;
+    data[4] = (state) ? ((left_handed) ? (4-one_finger_tap) : one_finger_tap) : 0;
+    data[5] = (state) ? ((left_handed) ? (4-two_finger_tap) : two_finger_tap) : 0;
+    data[6] = (state) ? three_finger_tap : 0;
+}
+
+static void
+configure_button_layout (guchar   *buttons,
+                         int       n_buttons,
+                         bool      left_handed)
+{
+    const int left_button = 1;
+    int right_button;
+    int i;
+
+    /* if the button is higher than 2 (3rd button) then it's
+     * probably one direction of a scroll wheel or something else
+     * uninteresting
+     */
+    right_button = MIN (n_buttons, 3);
+
+    /* If we change things we need to make sure we only swap buttons.
+     * If we end up with multiple physical buttons assigned to the same
+     * logical button the server will complain. This code assumes physical
+     * button 0 is the physical left mouse button, and that the physical
+     * button other than 0 currently assigned left_button or right_button
+     * is the physical right mouse button.
+     */
+    /* check if the current mapping satisfies the above assumptions */
+    if (buttons[left_button - 1] != left_button &&
+        buttons[left_button - 1] != right_button)
+            /* The current mapping is weird. Swapping buttons is probably not a
+             * good idea.
+             */
+            return;
+
+    /* check if we are left_handed and currently not swapped */
+    if (left_handed && buttons[left_button - 1] == left_button) {
+            /* find the right button */
+            for (i = 0; i < n_buttons; i++) {
+                    if (buttons[i] == right_button) {
+                            buttons[i] = left_button;
+                            break;
+                    }
+            }
+            /* swap the buttons */
+            buttons[left_button - 1] = right_button;
+    }
+    /* check if we are not left_handed but are swapped */
+    else if (!left_handed && buttons[left_button - 1] == right_button) {
+            /* find the right button */
+            for (i = 0; i < n_buttons; i++) {
+                    if (buttons[i] == left_button) {
+                            buttons[i] = right_button;
+                            break;
+                    }
+            }
+            /* swap the buttons */
+            buttons[left_button - 1] = left_button;
+    }
+}
+
+void InputWorker::setLeftHandedLegacyDriver (ApplyPlan       *plan,
+                                             bool         mouse_left_handed,
+                                             bool         touchpad_left_handed)
+{
+    InputDevice *dev = plan->dev;
+    unsigned char *buttons;
+    unsigned long  buttons_capacity = 16;
+    int     n_buttons;
+    bool    left_handed;
+
+    if (!dev->buttons)
+            return;
+
+    /* If the device is a touchpad, swap tap buttons
+     * around too, otherwise a tap would be a right-click */
+    if (dev->touchpad) {
+            bool tap = mSettings.tap_to_click;
+            bool single_button = touchpad_has_single_button (plan);
+
+            left_handed = touchpad_left_handed;
+
+            if (tap && !single_button)
+                    set_tap_to_click_synaptics (plan, tap, left_handed,
+                                                mSettings.one_finger_tap,
+                                                mSettings.two_finger_tap,
+                                                mSettings.three_finger_tap);
+
+            if (single_button)
+                    return;
+    } else {
+            left_handed = mouse_left_handed;
+    }
+
+    /* 按键映射不是设备属性，XI2 没有对应请求，仍通过 XI1 设置 */
+    buttons = g_new (guchar, buttons_capacity);
+
+    n_buttons = XGetDeviceButtonMapping (plan->display, dev->device,
+                                         buttons,
+                                         buttons_capacity);
+
+    while (n_buttons > (int)buttons_capacity) {
+            buttons_capacity = n_buttons;
+            buttons = (guchar *) g_realloc (buttons,
+                                            buttons_capacity * sizeof (guchar));
+
+            n_buttons = XGetDeviceButtonMapping (plan->display, dev->device,
+                                                 buttons,
+                                                 buttons_capacity);
+    }
+
+    configure_button_layout (buttons, n_buttons, left_handed);
+
+    XSetDeviceButtonMapping (plan->display, dev->device, buttons, n_buttons);
+
+    g_free (buttons);
+}
+
+void InputWorker::setLeftHanded (ApplyPlan    *plan,
+                                 bool         mouse_left_handed,
+                                 bool         touchpad_left_handed)
+{
+    if (device_has_property (plan->dev, "libinput Left Handed Enabled"))
+        set_left_handed_libinput (plan, mouse_left_handed, touchpad_left_handed);
+    else
+        setLeftHandedLegacyDriver (plan, mouse_left_handed, touchpad_left_handed);
+}
+
+void InputWorker::setMotionLibinput (ApplyPlan       *plan)
+{
+    float accel;
+    float motion_acceleration;
+
+    /* Calculate acceleration */
+    motion_acceleration = plan->dev->touchpad ? mSettings.touchpad_motion_acceleration
+                                              : mSettings.mouse_motion_acceleration;
+
+    /* panel gives us a range of 1.0-10.0, map to libinput's [-1, 1]
+     *
+     * oldrange = (oldmax - oldmin)
+     * newrange = (newmax - newmin)
+     *
+     * mapped = (value - oldmin) * newrange / oldrange + oldmin
+     */
+
+    if (motion_acceleration == -1.0) /* unset */
+            accel = 0.0;
+    else
+            accel = (motion_acceleration - 1.0) * 2.0 / 9.0 - 1;
+
+    property_set_float (plan, "libinput Accel Speed", accel);
+}
+
+void InputWorker::setMotionLegacyDriver (ApplyPlan       *plan)
+{
+    InputDevice *dev = plan->dev;
+    XPtrFeedbackControl feedback;
+    XFeedbackState *states, *state;
+    int num_feedbacks, i;
+    double motion_acceleration;
+    int motion_threshold;
+    int numerator, denominator;
+
+    /* Calculate acceleration */
+    motion_acceleration = dev->touchpad ? mSettings.touchpad_motion_acceleration
+                                        : mSettings.mouse_motion_acceleration;
+
+    if (motion_acceleration >= 1.0) {
+            /* we want to get the acceleration, with a resolution of 0.5
+             */
+            if ((motion_acceleration - floor (motion_acceleration)) < 0.25) {
+                    numerator = floor (motion_acceleration);
+                    denominator = 1;
+            } else if ((motion_acceleration - floor (motion_acceleration)) < 0.5) {
+                    numerator = ceil (2.0 * motion_acceleration);
+                    denominator = 2;
+            } else if ((motion_acceleration - floor (motion_acceleration)) < 0.75) {
+                    numerator = floor (2.0 *motion_acceleration);
+                    denominator = 2;
+            } else {
+                    numerator = ceil (motion_acceleration);
+                    denominator = 1;
+            }
+    } else if (motion_acceleration < 1.0 && motion_acceleration > 0) {
+            /* This we do to 1/10ths */
+            numerator = floor (motion_acceleration * 10) + 1;
+            denominator= 10;
+    } else {
+            numerator = -1;
+            denominator = -1;
+    }
+
+    /* And threshold */
+    motion_threshold = dev->touchpad ? mSettings.touchpad_motion_threshold
+                                     : mSettings.mouse_motion_threshold;
+    /* Get the list of feedbacks for the device */
+    states = XGetFeedbackControl (plan->display, dev->device, &num_feedbacks);
+    if (states == NULL)
+            return;
+
+    state = (XFeedbackState *) states;
+    for (i = 0; i < num_feedbacks; i++) {
+        if (state->c_class == PtrFeedbackClass) {
+            XPtrFeedbackState *current = (XPtrFeedbackState *) state;
+
+            /* 与当前值相同时不再设置 */
+            if (current->accelNum == numerator && current->accelDenom == denominator &&
+                current->threshold == motion_threshold)
+                break;
+
+            /* And tell the device */
+            feedback.c_class      = PtrFeedbackClass;
+            feedback.length     = sizeof (XPtrFeedbackControl);
+            feedback.id         = state->id;
+            feedback.threshold  = motion_threshold;
+            feedback.accelNum   = numerator;
+            feedback.accelDenom = denominator;
+
+            qDebug ("Setting accel %d/%d, threshold %d for device '%s'",
+                     numerator, denominator, motion_threshold, dev->name.toLocal8Bit().data());
+
+            XChangeFeedbackControl (plan->display,
+                                    dev->device,
+                                    DvAccelNum | DvAccelDenom | DvThreshold,
+                                    (XFeedbackControl *) &feedback);
+            break;
+        }
+        state = (XFeedbackState *) ((char *) state + state->length);
+    }
+    XFreeFeedbackList (states);
+}
+
+void InputWorker::setTouchpadMotionAccel(ApplyPlan *plan)
+{
+    float accel;
+    float motion_acceleration;
+
+    if (!plan->dev->touchpad)
+        return;
+
+    /* Calculate acceleration */
+    motion_acceleration = mSettings.touchpad_motion_acceleration;
+    if (motion_acceleration == -1.0) /* unset */
+            accel = 0.0;
+    else
+            accel = motion_acceleration;
+
+    property_set_float (plan, "Device Accel Constant Deceleration", accel);
+}
+
+void InputWorker::setMouseAccel(ApplyPlan *plan)
+{
+    PlanProperty *item;
+
+    item = apply_plan_get (plan, "libinput Accel Profile Enabled", XA_INTEGER, 8, 2);
+    if (!item)
+        return;
+
+    if(mSettings.mouse_accel){
+        item->desired[0] = 1;
+        item->desired[1] = 0;
+    }else{
+        item->desired[0] = 0;
+        item->desired[1] = 1;
+    }
+}
+
+void InputWorker::setMotion (ApplyPlan      *plan)
+{
+    if (device_has_property (plan->dev, "libinput Accel Speed"))
+        setMotionLibinput (plan);
+    else
+        setMotionLegacyDriver (plan);
+
+    if(device_has_property (plan->dev, "Device Accel Constant Deceleration"))
+        setTouchpadMotionAccel(plan);
+
+    if(device_has_property (plan->dev, "libinput Accel Profile Enabled")) {
+        setMouseAccel(plan);
+    }
+}
+
+void InputWorker::setMiddleButton (ApplyPlan   *plan,
+                                   bool     middle_button)
+{
+    PlanProperty *item;
+
+    item = apply_plan_get (plan, "Evdev Middle Button Emulation", XA_INTEGER, 8, 1);
+    if (item && item->nitems == 1)
+        item->desired[0] = middle_button ? 1 : 0;
+
+    property_set_bool (plan, "libinput Middle Emulation Enabled", 0, middle_button);
+}
+
+static void
+set_tap_to_click (ApplyPlan *plan,  bool state,  bool left_handed,
+                  int one_finger_tap, int two_finger_tap, int three_finger_tap)
+{
+        if (device_has_property (plan->dev, "Synaptics Tap Action"))
+                set_tap_to_click_synaptics (plan, state, left_handed,
+                                            one_finger_tap, two_finger_tap, three_finger_tap);
+
+        if (device_has_property (plan->dev, "libinput Tapping Enabled"))
+                touchpad_set_bool (plan, "libinput Tapping Enabled", 0, state);
+}
+
+void InputWorker::setTapToClick (ApplyPlan *plan)
+{
+    if (!plan->dev->touchpad)
+        return;
+
+    set_tap_to_click (plan, mSettings.tap_to_click, mSettings.touchpad_left_handed,
+                      mSettings.one_finger_tap, mSettings.two_finger_tap,
+                      mSettings.three_finger_tap);
+}
+
+static void set_scrolling_synaptics (ApplyPlan           *plan,
+                                     const InputSettings *settings)
+{
+    /* 同一属性的两项在计划中合并为一次写入 */
+    touchpad_set_bool (plan, "Synaptics Edge Scrolling", 0, settings->vert_edge_scroll);
+    touchpad_set_bool (plan, "Synaptics Edge Scrolling", 1, settings->horiz_edge_scroll);
+    touchpad_set_bool (plan, "Synaptics Two-Finger Scrolling", 0, settings->vert_two_finger_scroll);
+    touchpad_set_bool (plan, "Synaptics Two-Finger Scrolling", 1, settings->horiz_two_finger_scroll);
+}
+
+
+static void set_scrolling_libinput (ApplyPlan           *plan,
+                                    const InputSettings *settings)
+{
+    PlanProperty *item;
+    bool want_edge, want_2fg;
+    bool want_horiz;
+
+    if (!plan->dev->touchpad)
+            return;
+
+    want_2fg = settings->vert_two_finger_scroll;
+    want_edge  = settings->vert_edge_scroll;
+
+    /* libinput only allows for one scroll method at a time.
+     * If both are set, pick 2fg scrolling.
+     */
+    if (want_2fg)
+            want_edge = false;
+
+    item = apply_plan_get (plan, "libinput Scroll Method Enabled", XA_INTEGER, 8, 3);
+    if (item) {
+            item->desired[0] = want_2fg;
+            item->desired[1] = want_edge;
+    }
+
+    /* Horizontal scrolling is handled by xf86-input-libinput and
+     * there's only one bool. Pick the one matching the scroll method
+     * we picked above.
+     */
+    if (want_2fg)
+        want_horiz = settings->horiz_two_finger_scroll;
+    else if (want_edge)
+        want_horiz = settings->horiz_edge_scroll;
+    else
+        return;
+    touchpad_set_bool (plan, "libinput Horizontal Scroll Enabled", 0, want_horiz);
+}
+
+void InputWorker::setScrolling (ApplyPlan *plan)
+ {
+     if (device_has_property (plan->dev, "Synaptics Edge Scrolling"))
+         set_scrolling_synaptics (plan, &mSettings);
+
+     if (device_has_property (plan->dev, "libinput Scroll Method Enabled"))
+         set_scrolling_libinput (plan, &mSettings);
+ }
+
+static void
+set_natural_scroll_synaptics (ApplyPlan   *plan,
+                              bool         natural_scroll)
+{
+    PlanProperty *item;
+    gint32 *ptr;
+
+    if (!plan->dev->touchpad)
+            return;
+
+    /* XI2 中 32 位格式的属性按 32 位整数存放 */
+    item = apply_plan_get (plan, "Synaptics Scrolling Distance", XA_INTEGER, 32, 2);
+    if (!item)
+            return;
+
+    ptr = (gint32 *) item->desired;
+    if (natural_scroll) {
+            ptr[0] = -abs(ptr[0]);
+            ptr[1] = -abs(ptr[1]);
+    } else {
+            ptr[0] = abs(ptr[0]);
+            ptr[1] = abs(ptr[1]);
+    }
+}
+
+static void
+set_natural_scroll (ApplyPlan   *plan,
+                    bool         natural_scroll)
+{
+    if (device_has_property (plan->dev, "Synaptics Scrolling Distance"))
+        set_natural_scroll_synaptics (plan, natural_scroll);
+
+    if (device_has_property (plan->dev, "libinput Natural Scrolling Enabled"))
+        touchpad_set_bool (plan, "libinput Natural Scrolling Enabled", 0, natural_scroll);
+}
+
+static void
+set_touchpad_enabled (ApplyPlan   *plan,
+                      bool         state)
+{
+    touchpad_set_bool (plan, "Device Enabled", 0, state);
+}
+
+static void
+set_touchpad_double_click (ApplyPlan *plan, bool state)
+{
+    touchpad_set_bool (plan, "Synaptics Gestures", 0, state);
+}
+
+//设置关闭右下角菜单
+void InputWorker::setBottomRightClickMenu(ApplyPlan *plan, bool state)
+{
+    PlanProperty *item;
+    gint32 *ptr;
+
+    if (!plan->dev->touchpad)
+            return;
+    item = apply_plan_get (plan, "Synaptics Soft Button Areas", XA_INTEGER, 32, 3);
+    if (!item)
+            return;
+
+    ptr = (gint32 *) item->desired;
+    if(ptr[0] != 0){
+        mAreaLeft = ptr[0];
+        mAreaTop  = ptr[2];
+    }
+    if (state) {
+        ptr[0] = mAreaLeft;
+        ptr[2] = mAreaTop;
+    } else {
+        ptr[0] = 0;
+        ptr[2] = 0;
+    }
+}
+
+/* 鼠标滚轮由界面线程的 WheelScaler 放大，这里只设置触摸板的滚动距离 */
+void InputWorker::setWheelSpeed(ApplyPlan *plan, int speed)
+{
+    PlanProperty *item;
+
+    if (speed <= 0 || !plan->dev->touchpad)
+        return;
+
+    /* libinput 默认每 15 像素对应一格，可调范围 10-50 */
+    item = apply_plan_get (plan, "libinput Scrolling Pixel Distance", XA_CARDINAL, 32, 1);
+    if (item)
+        *(guint32 *) item->desired = MAX (10, 15 / speed);
+}
+
+/**
+ * 把 mask 指定的各项设置应用到一个设备。
+ * 设备能力来自缓存，各项设置先汇总到一个应用计划中，
+ * 只写回发生变化的属性；整个过程只在最后同步一次
+ */
+void InputWorker::applyDevice (InputDevice *dev, uint mask)
+{
+    ApplyPlan *plan;
+    int        written;
+
+    if (mask == 0)
+        return;
+
+    worker_error_trap_push ();
+    plan = apply_plan_new (dev);
+
+    if (mask & SETTING_LEFT_HANDED)
+        setLeftHanded (plan, mSettings.mouse_left_handed, mSettings.touchpad_left_handed);
+    if (mask & SETTING_MOTION)
+        setMotion (plan);
+    if (mask & SETTING_MIDDLE_BUTTON)
+        setMiddleButton (plan, mSettings.middle_button);
+    if (mask & SETTING_DISABLE_W_TYPING)
+        touchpad_set_bool (plan, "libinput Disable While Typing Enabled", 0,
+                           mSettings.disable_w_typing);
+    if (mask & SETTING_TAP_TO_CLICK)
+        setTapToClick (plan);
+    if (mask & SETTING_SCROLLING)
+        setScrolling (plan);
+    if (mask & SETTING_NATURAL_SCROLL)
+        set_natural_scroll (plan, mSettings.natural_scroll);
+    if (mask & SETTING_TOUCHPAD_ENABLED)
+        set_touchpad_enabled (plan, mSettings.touchpad_enabled);
+    if (mask & SETTING_DOUBLE_CLICK_DRAG)
+        set_touchpad_double_click (plan, mSettings.double_click_drag);
+    if (mask & SETTING_BOTTOM_R_C_CLICK_M)
+        setBottomRightClickMenu (plan, mSettings.bottom_right_click_menu);
+    if (mask & SETTING_WHEEL_SPEED)
+        setWheelSpeed (plan, mSettings.wheel_speed);
+
+    written = apply_plan_commit (plan);
+
+    if (worker_error_trap_pop (mDisplay))
+        qWarning ("Error while configuring \"%s\"", dev->name.toLocal8Bit().data());
+    else if (written > 0)
+        qDebug ("%d properties changed on \"%s\"", written, dev->name.toLocal8Bit().data());
+}
+
+/* 有 synaptics 触摸板且开启了打字时禁用时才接收按键信号 */
+void InputWorker::updateTypingMonitor()
+{
+    bool want = false;
+
+    if (mHaveSettings && mSettings.disable_w_typing) {
+        Q_FOREACH (InputDevice *dev, mDevices) {
+            if (dev->synaptics && dev->touchpad) {
+                want = true;
+                break;
+            }
+        }
+    }
+    mTypingTimer->setInterval (mSettings.disable_w_typing_timeout > 0 ?
+                               mSettings.disable_w_typing_timeout : 500);
+    if (want == mTypingMonitor)
+        return;
+
+    if (want) {
+        XEventMonitor::instance()->start();
+        connect(XEventMonitor::instance(), SIGNAL(keyPress(int)), this, SLOT(keyPressed(int)));
+        connect(XEventMonitor::instance(), SIGNAL(keyRelease(int)), this, SLOT(keyReleased(int)));
+    } else {
+        disconnect(XEventMonitor::instance(), nullptr, this, nullptr);
+        mTypingTimer->stop();
+        mModifiersDown.clear();
+        if (mTouchpadOff)
+            setSynapticsOff (false);
+    }
+    mTypingMonitor = want;
+}
+
+void InputWorker::keyPressed(int keyCode)
+{
+    if (!mDisplay)
+        return;
+
+    if (mModifierKeys.contains (keyCode)) {
+        mModifiersDown.insert (keyCode);
+        return;
+    }
+    /* 与 syndaemon -K 相同，修饰键组合（快捷键）不算打字 */
+    if (!mModifiersDown.isEmpty())
+        return;
+
+    if (!mTouchpadOff)
+        setSynapticsOff (true);
+    mTypingTimer->start();
+}
+
+void InputWorker::keyReleased(int keyCode)
+{
+    mModifiersDown.remove (keyCode);
+}
+
+void InputWorker::typingIdle()
+{
+    if (mDisplay && mTouchpadOff)
+        setSynapticsOff (false);
+}
+
+/* 一次连续输入只在开始和结束时各写一次属性 */
+void InputWorker::setSynapticsOff(bool off)
+{
+    worker_error_trap_push ();
+    Q_FOREACH (InputDevice *dev, mDevices) {
+        ApplyPlan *plan;
+
+        if (!dev->synaptics || !dev->touchpad)
+            continue;
+        plan = apply_plan_new (dev);
+        property_set_bool (plan, "Synaptics Off", 0, off);
+        apply_plan_commit (plan);
+    }
+    if (worker_error_trap_pop (mDisplay))
+        qWarning ("Error while %s touchpad", off ? "disabling" : "enabling");
+    mTouchpadOff = off;
+}
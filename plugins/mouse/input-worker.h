@@ -0,0 +1,183 @@
+/* -*- Mode: C++; indent-tabs-mode: nil; tab-width: 4 -*-
+ * -*- coding: utf-8 -*-
+ *
+ * Copyright (C) 2020 KylinSoft Co., Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef INPUTWORKER_H
+#define INPUTWORKER_H
+
+#include <QObject>
+#include <QString>
+#include <QHash>
+#include <QAtomicInt>
+#include <QSet>
+#include <QMetaType>
+
+#include <X11/Xlib.h>
+
+class QThread;
+class QTimer;
+class QSocketNotifier;
+
+/* 鼠标/触摸板设置项，每项对应一组设备属性 */
+enum {
+    SETTING_LEFT_HANDED         = 1 << 0,
+    SETTING_MOTION              = 1 << 1,
+    SETTING_MIDDLE_BUTTON       = 1 << 2,
+    SETTING_DISABLE_W_TYPING    = 1 << 3,
+    SETTING_TAP_TO_CLICK        = 1 << 4,
+    SETTING_SCROLLING           = 1 << 5,
+    SETTING_NATURAL_SCROLL      = 1 << 6,
+    SETTING_TOUCHPAD_ENABLED    = 1 << 7,
+    SETTING_DOUBLE_CLICK_DRAG   = 1 << 8,
+    SETTING_BOTTOM_R_C_CLICK_M  = 1 << 9,
+    SETTING_WHEEL_SPEED         = 1 << 10,
+    SETTING_ALL                 = (1 << 11) - 1
+};
+
+/* 设置快照，在界面线程读取，随命令一起交给工作线程 */
+typedef struct {
+    bool    mouse_left_handed;
+    bool    touchpad_left_handed;
+    double  mouse_motion_acceleration;
+    int     mouse_motion_threshold;
+    bool    mouse_accel;
+    double  touchpad_motion_acceleration;
+    int     touchpad_motion_threshold;
+    bool    middle_button;
+    bool    disable_w_typing;
+    int     disable_w_typing_timeout;   /* 毫秒，synaptics 在最后一次按键后恢复的时间 */
+    bool    tap_to_click;
+    int     one_finger_tap;
+    int     two_finger_tap;
+    int     three_finger_tap;
+    bool    vert_edge_scroll;
+    bool    horiz_edge_scroll;
+    bool    vert_two_finger_scroll;
+    bool    horiz_two_finger_scroll;
+    bool    natural_scroll;
+    bool    touchpad_enabled;
+    bool    double_click_drag;
+    bool    bottom_right_click_menu;
+    int     wheel_speed;        /* 0 表示未设置过，保持驱动默认值 */
+} InputSettings;
+
+/* 工作线程报告给界面线程的设备概要 */
+typedef struct {
+    int     id;
+    QString name;
+    bool    touchpad;
+    bool    synaptics;
+    bool    buttons;            /* 带有按键 */
+} InputDeviceSummary;
+
+Q_DECLARE_METATYPE(InputSettings)
+Q_DECLARE_METATYPE(InputDeviceSummary)
+
+struct InputDevice;
+typedef struct _ApplyPlan ApplyPlan;
+
+/**
+ * 输入设备配置线程
+ * 设备能力缓存、属性应用计划和所有 XInput 请求都在独立线程中、
+ * 通过线程自己的 X 连接完成；设备热插拔也由该连接上的 XI2
+ * 层级事件直接接收，不再经过 GDK 的事件过滤器。
+ * 大量设备同时插拔时，界面线程和快捷键处理不会被阻塞。
+ *
+ * synaptics 触摸板的打字时禁用也在这里完成：由 XEventMonitor 的按键信号驱动，
+ * 按键时设置 "Synaptics Off"，空闲一段时间后恢复，不再启动 syndaemon 轮询键盘。
+ *
+ * 设置改变以命令的形式投递，按投递顺序依次执行；
+ * 所有已投递的命令及随后到达的设备事件处理完后发出 quiesced()。
+ */
+class InputWorker : public QObject
+{
+    Q_OBJECT
+
+public:
+    InputWorker();
+    ~InputWorker();
+
+    void start();
+    /* 等待已投递的命令执行完，关闭设备和 X 连接 */
+    void stop();
+
+    /* 把 settings 中 mask 指定的设置项应用到所有设备，新出现的设备应用最近一次的快照 */
+    void applySettings(const InputSettings &settings, uint mask);
+    /* 没有尚未执行的命令 */
+    bool isQuiesced() const;
+
+Q_SIGNALS:
+    void deviceAdded(InputDeviceSummary device);
+    void deviceRemoved(int id);
+    void quiesced();
+
+private Q_SLOTS:
+    void init();
+    void shutdown();
+    void runApplySettings(InputSettings settings, uint mask);
+    void processEvents();
+    void keyPressed(int keyCode);
+    void keyReleased(int keyCode);
+    void typingIdle();
+
+private:
+    void post(const char *method, QGenericArgument arg0 = QGenericArgument(),
+              QGenericArgument arg1 = QGenericArgument());
+    void finishCommand();
+
+    void loadDevices();
+    void addDevice(XID id);
+    void removeDevice(XID id);
+    void applyDevice(InputDevice *dev, uint mask);
+
+    void setLeftHanded(ApplyPlan *plan, bool mouse_left_handed, bool touchpad_left_handed);
+    void setLeftHandedLegacyDriver(ApplyPlan *plan, bool mouse_left_handed, bool touchpad_left_handed);
+    void setMotion(ApplyPlan *plan);
+    void setMotionLibinput(ApplyPlan *plan);
+    void setMotionLegacyDriver(ApplyPlan *plan);
+    void setMouseAccel(ApplyPlan *plan);
+    void setTouchpadMotionAccel(ApplyPlan *plan);
+    void setTapToClick(ApplyPlan *plan);
+    void setScrolling(ApplyPlan *plan);
+    void setBottomRightClickMenu(ApplyPlan *plan, bool state);
+    void setMiddleButton(ApplyPlan *plan, bool middle_button);
+    void setWheelSpeed(ApplyPlan *plan, int speed);
+
+    void updateTypingMonitor();
+    void setSynapticsOff(bool off);
+
+private:
+    QThread         *mThread;
+    QAtomicInt       mPending;      /* 已投递、尚未执行完的命令数 */
+
+    /* 以下只在工作线程中访问 */
+    Display         *mDisplay;
+    int              mOpcode;       /* XInputExtension 的主操作码 */
+    QSocketNotifier *mNotifier;
+    QHash<XID, InputDevice*> mDevices;
+    InputSettings    mSettings;
+    bool             mHaveSettings;
+    unsigned long    mAreaLeft;
+    unsigned long    mAreaTop;
+    QTimer          *mTypingTimer;
+    QSet<int>        mModifierKeys;     /* 修饰键的键码，修饰键组合不算打字 */
+    QSet<int>        mModifiersDown;
+    bool             mTypingMonitor;    /* 已连接按键信号 */
+    bool             mTouchpadOff;      /* 因打字已关闭 synaptics 触摸板 */
+};
+
+#endif // INPUTWORKER_H
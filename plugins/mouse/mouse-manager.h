@@ -22,11 +22,14 @@
 #include <QDebug>
 #include <QObject>
 #include <QTimer>
-#include <QDir>
-#include <QProcess>
+#include <QHash>
+#include <QSet>
 #include <QtX11Extras/QX11Info>
 #include <QGSettings/qgsettings.h>
 
+#include "wheel-scaler.h"
+#include "input-worker.h"
+
 
 #include <glib.h>
 #include <errno.h>
@@ -36,7 +39,6 @@
 #include <X11/keysym.h>
 #include <X11/Xatom.h>
 #include <X11/extensions/XInput.h>
-#include <X11/extensions/XIproto.h>
 
 class MouseManager : public QObject
 {
@@ -55,63 +57,34 @@ public:
 
 public Q_SLOTS:
     void MouseManagerIdleCb();
-    void MouseCallback(QString);
-    void TouchpadCallback(QString);
+    void MouseCallback(QStringList);
+    void TouchpadCallback(QStringList);
+    void DeviceAddedCallback(InputDeviceSummary device);
+    void DeviceRemovedCallback(int id);
 
 public:
-    void SetLeftHandedAll (bool mouse_left_handed,
-                           bool touchpad_left_handed);
-    void SetLeftHanded  (XDeviceInfo  *device_info,
-                         bool         mouse_left_handed,
-                         bool         touchpad_left_handed);
-    void SetLeftHandedLegacyDriver (XDeviceInfo     *device_info,
-                                    bool         mouse_left_handed,
-                                    bool         touchpad_left_handed);
-
-    void SetMotionAll ();
-    void SetMotion   (XDeviceInfo  *device_info);
-    void SetMotionLibinput (XDeviceInfo  *device_info);
-    void SetMotionLegacyDriver(XDeviceInfo     *device_info);
+    InputSettings ReadSettings ();
     bool GetTouchpadHandedness (bool mouse_left_handed);
-    void SetMouseAccel(XDeviceInfo  *device_info);
-    void SetTouchpadStateAll(int num, bool state);
-    void SetTouchpadMotionAccel(XDeviceInfo *device_info);
-    void SetBottomRightClickMenu (XDeviceInfo *device_info, bool state);
-    void SetBottomRightConrnerClickMenu(bool state);
 
-    void SetDisableWTyping  (bool state);
-    void SetDisableWTypingSynaptics (bool state);
-    void SetDisableWTypingLibinput  (bool state);
-
-    void SetMiddleButtonAll   (bool middle_button);
-    void SetMiddleButton      (XDeviceInfo *device_info,
-                               bool     middle_button);
     void SetLocatePointer     (bool     state);
-    void SetTapToClickAll ();
-    void SetNaturalScrollAll ();
-    void SetDevicepresenceHandler ();
+    void SetPlugMouseDisbleTouchpad (const InputDeviceSummary *dev);
     void SetMouseWheelSpeed (int speed);
+    void UpdateWheelDevices ();
     void SetMouseSettings();
 
-private: 
-    friend GdkFilterReturn devicepresence_filter (GdkXEvent *xevent,
-                                                  GdkEvent  *event,
-                                                  gpointer   data);
-
 private:
-    unsigned long mAreaLeft;
-    unsigned long mAreaTop;
     QTimer * time;
     QGSettings *settings_mouse;
     QGSettings *settings_touchpad;
+    InputWorker *mWorker;
+    QHash<int, InputDeviceSummary> mDevices;   /* 工作线程报告的设备 */
 #if 0   /* FIXME need to fork (?) mousetweaks for this to work */
     gboolean mousetweaks_daemon_running;
 #endif
-    gboolean syndaemon_spawned;
-    GPid     syndaemon_pid;
     gboolean locate_pointer_spawned;
     GPid     locate_pointer_pid;
-    bool     imwheelSpawned;
+    int      mWheelSpeed;       /* 0 表示未设置过，保持驱动默认值 */
+    WheelScaler *mWheelScaler;
 
     static MouseManager *mMouseManager;
 };
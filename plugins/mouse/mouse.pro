@@ -22,19 +22,24 @@ PKGCONFIG += \
         gtk+-3.0 \
         glib-2.0  \
         gsettings-qt \
-        xi
+        xi \
+        xtst
 
 
 INCLUDEPATH += \
         -I ukui-settings-daemon/
 
 SOURCES += \
+    input-worker.cpp \
     mouse-manager.cpp \
     mouse-plugin.cpp \
+    wheel-scaler.cpp \
 
 HEADERS += \
+    input-worker.h \
     mouse-manager.h \
     mouse-plugin.h \
+    wheel-scaler.h \
 
 mouse_lib.path = $${PLUGIN_INSTALL_DIRS}
 mouse_lib.files = $$OUT_PWD/libmouse.so
@@ -0,0 +1,248 @@
+/* -*- Mode: C++; indent-tabs-mode: nil; tab-width: 4 -*-
+ * -*- coding: utf-8 -*-
+ *
+ * Copyright (C) 2020 KylinSoft Co., Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <poll.h>
+#include <errno.h>
+#include <unistd.h>
+#include <glib-unix.h>
+
+#include <QHash>
+
+#include <X11/Xlib.h>
+#include <X11/XKBlib.h>
+#include <X11/extensions/XInput2.h>
+#include <X11/extensions/XTest.h>
+
+#include "wheel-scaler.h"
+#include "clib-syslog.h"
+
+/* 从设备的竖直滚动轴 */
+typedef struct {
+    int     number;         /* 轴号，-1 表示没有竖直滚动轴 */
+    double  increment;      /* 一格滚动对应的值，负数表示方向相反 */
+    double  pending;        /* 不足一格的累计值 */
+} ScrollAxis;
+
+static ScrollAxis
+query_scroll_axis (Display *display, int deviceid)
+{
+    ScrollAxis    axis = { -1, 0.0, 0.0 };
+    XIDeviceInfo *info;
+    int           n, i;
+
+    info = XIQueryDevice (display, deviceid, &n);
+    if (info == NULL)
+        return axis;
+
+    for (i = 0; i < info->num_classes; i++) {
+        XIScrollClassInfo *scroll = (XIScrollClassInfo *) info->classes[i];
+
+        if (scroll->type != XIScrollClass || scroll->scroll_type != XIScrollTypeVertical ||
+            scroll->increment == 0.0)
+            continue;
+        axis.number = scroll->number;
+        axis.increment = scroll->increment;
+        break;
+    }
+    XIFreeDeviceInfo (info);
+    return axis;
+}
+
+/* 与原先的 imwheel 配置一致，按住 Ctrl 或 Shift 时的滚动(缩放等)不放大 */
+static bool
+modifiers_held (Display *display)
+{
+    XkbStateRec state;
+
+    if (XkbGetState (display, XkbUseCoreKbd, &state) != Success)
+        return false;
+    return (state.mods & (ControlMask | ShiftMask)) != 0;
+}
+
+/* 补发 count 次竖直滚轮点击，button 为 4(向上) 或 5(向下) */
+static void
+fake_wheel_clicks (Display *display, unsigned int button, int count)
+{
+    for (int i = 0; i < count; i++) {
+        XTestFakeButtonEvent (display, button, True, CurrentTime);
+        XTestFakeButtonEvent (display, button, False, CurrentTime);
+    }
+    XFlush (display);
+}
+
+WheelScaler::WheelScaler(QObject *parent)
+    : QThread(parent),
+      mSpeed(1),
+      mDevicesChanged(0)
+{
+    if (!g_unix_open_pipe (mWakeup, FD_CLOEXEC, NULL))
+        mWakeup[0] = mWakeup[1] = -1;
+}
+
+WheelScaler::~WheelScaler()
+{
+    requestInterruption();
+    if (mWakeup[1] >= 0) {
+        /* 管道满时线程已有待处理的唤醒，忽略写入失败 */
+        if (write (mWakeup[1], "q", 1) < 0) {}
+    }
+    wait();
+
+    if (mWakeup[0] >= 0) {
+        close (mWakeup[0]);
+        close (mWakeup[1]);
+    }
+}
+
+void WheelScaler::setSpeed(int speed)
+{
+    mSpeed.store(speed > 1 ? speed : 1);
+}
+
+void WheelScaler::setDevices(const QSet<int> &devices)
+{
+    QMutexLocker locker(&mLock);
+    mDevices = devices;
+    mDevicesChanged.store(1);
+}
+
+bool WheelScaler::isScaled(int device)
+{
+    QMutexLocker locker(&mLock);
+    return mDevices.contains(device);
+}
+
+void WheelScaler::run()
+{
+    Display       *display;
+    XIEventMask    mask;
+    unsigned char  bits[XIMaskLen (XI_LASTEVENT)] = { 0 };
+    int            opcode, event, error;
+    int            major = 2, minor = 2;
+    struct pollfd  fds[2];
+
+    if (mWakeup[0] < 0)
+        return;
+
+    display = XOpenDisplay (NULL);
+    if (display == NULL) {
+        CT_SYSLOG (LOG_WARNING, "wheel: unable to open display");
+        return;
+    }
+    if (!XQueryExtension (display, "XInputExtension", &opcode, &event, &error) ||
+        XIQueryVersion (display, &major, &minor) != Success) {
+        CT_SYSLOG (LOG_WARNING, "wheel: XInput 2 is not available");
+        XCloseDisplay (display);
+        return;
+    }
+
+    /**
+     * 原始事件总是发送到根窗口，不受其他客户端抓取的影响。
+     * 只选择主设备：从设备和主设备都会报告同一个事件，sourceid 相同。
+     * libinput 和 evdev 以滚动轴的 RawMotion 报告滚轮，兼容的 4/5 按键
+     * 由服务器模拟，不产生原始事件；只有直接报告按键的驱动才有 RawButtonPress
+     */
+    mask.deviceid = XIAllMasterDevices;
+    mask.mask_len = sizeof (bits);
+    mask.mask = bits;
+    XISetMask (bits, XI_RawMotion);
+    XISetMask (bits, XI_RawButtonPress);
+    XISelectEvents (display, DefaultRootWindow (display), &mask, 1);
+    XFlush (display);
+
+    fds[0].fd = ConnectionNumber (display);
+    fds[0].events = POLLIN;
+    fds[1].fd = mWakeup[0];
+    fds[1].events = POLLIN;
+
+    QHash<int, ScrollAxis> axes;
+
+    while (!isInterruptionRequested()) {
+        /* 设备增减后重新查询滚动轴 */
+        if (mDevicesChanged.fetchAndStoreOrdered(0))
+            axes.clear();
+
+        while (XPending (display)) {
+            XEvent               ev;
+            XGenericEventCookie *cookie = &ev.xcookie;
+            XIRawEvent          *raw;
+            int                  speed = mSpeed.load();
+
+            XNextEvent (display, &ev);
+            if (cookie->type != GenericEvent || cookie->extension != opcode ||
+                !XGetEventData (display, cookie))
+                continue;
+
+            raw = (XIRawEvent *) cookie->data;
+            if (speed <= 1 || !isScaled (raw->sourceid)) {
+                XFreeEventData (display, cookie);
+                continue;
+            }
+
+            if (cookie->evtype == XI_RawButtonPress) {
+                /* 只放大上下滚动 */
+                if ((raw->detail == 4 || raw->detail == 5) && !modifiers_held (display))
+                    fake_wheel_clicks (display, raw->detail, speed - 1);
+            } else if (cookie->evtype == XI_RawMotion) {
+                QHash<int, ScrollAxis>::iterator it = axes.find (raw->sourceid);
+                const double *value = raw->valuators.values;
+                double        delta = 0.0;
+                bool          found = false;
+                int           notches;
+
+                if (it == axes.end())
+                    it = axes.insert (raw->sourceid, query_scroll_axis (display, raw->sourceid));
+
+                for (int i = 0; it->number >= 0 && i < raw->valuators.mask_len * 8; i++) {
+                    if (!XIMaskIsSet (raw->valuators.mask, i))
+                        continue;
+                    if (i == it->number) {
+                        delta = *value;
+                        found = true;
+                        break;
+                    }
+                    value++;
+                }
+                if (!found || delta == 0.0) {
+                    XFreeEventData (display, cookie);
+                    continue;
+                }
+
+                /* 换方向时丢弃不足一格的累计值 */
+                if ((delta > 0) != (it->pending > 0))
+                    it->pending = 0.0;
+                it->pending += delta / it->increment;
+                notches = (int) it->pending;
+                it->pending -= notches;
+
+                if (notches != 0 && !modifiers_held (display))
+                    fake_wheel_clicks (display, notches > 0 ? 5 : 4,
+                                       ABS (notches) * (speed - 1));
+            }
+            XFreeEventData (display, cookie);
+        }
+
+        fds[0].revents = fds[1].revents = 0;
+        if (poll (fds, 2, -1) < 0 && errno != EINTR)
+            break;
+        if (fds[1].revents)
+            break;
+    }
+
+    XCloseDisplay (display);
+}
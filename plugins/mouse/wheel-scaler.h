@@ -0,0 +1,64 @@
+/* -*- Mode: C++; indent-tabs-mode: nil; tab-width: 4 -*-
+ * -*- coding: utf-8 -*-
+ *
+ * Copyright (C) 2020 KylinSoft Co., Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef WHEELSCALER_H
+#define WHEELSCALER_H
+
+#include <QThread>
+#include <QMutex>
+#include <QSet>
+#include <QAtomicInt>
+
+/**
+ * 进程内的滚轮速度调节
+ * 在独立线程和独立的 X 连接上监听 XI2 原始事件(滚动轴的移动和滚轮按键)，
+ * 不抓取指针，原始滚轮事件照常送达应用；对需要放大的设备，每格竖直滚动
+ * 再通过 XTest 补发 speed - 1 次滚轮点击。补发的事件来自 XTEST 设备，
+ * 不在设备集合中，因此不会被再次放大。按住 Ctrl 或 Shift 时不放大。
+ *
+ * 取代原先启动 imwheel 的方式：滚动不再经过额外的进程转发，
+ * 调整速度也不会阻塞界面线程。
+ */
+class WheelScaler : public QThread
+{
+    Q_OBJECT
+
+public:
+    WheelScaler(QObject *parent = nullptr);
+    ~WheelScaler();
+
+    /* 每格滚动对应的点击次数，1 表示不放大 */
+    void setSpeed(int speed);
+    /* 需要在进程内放大的从设备 */
+    void setDevices(const QSet<int> &devices);
+
+protected:
+    void run();
+
+private:
+    bool isScaled(int device);
+
+private:
+    QMutex      mLock;
+    QSet<int>   mDevices;
+    QAtomicInt  mSpeed;
+    QAtomicInt  mDevicesChanged;    /* 线程需要重新查询滚动轴 */
+    int         mWakeup[2];     /* 用于结束线程 */
+};
+
+#endif // WHEELSCALER_H
@@ -22,42 +22,28 @@
 #include "mpris-manager.h"
 #include <syslog.h>
 
-const QString MPRIS_OBJECT_PATH = "/org/mpris/MediaPlayer2";
-const QString MPRIS_INTERFACE = "org.mpris.MediaPlayer2.Player";
-const QString MPRIS_PREFIX = "org.mpris.MediaPlayer2.";
+#define MPRIS_OBJECT_PATH       "/org/mpris/MediaPlayer2"
+#define MPRIS_INTERFACE         "org.mpris.MediaPlayer2.Player"
+#define MPRIS_NAMESPACE         "org.mpris.MediaPlayer2"
+#define FREEDESKTOP_DBUS_NAME   "org.freedesktop.DBus"
+#define FREEDESKTOP_DBUS_PATH   "/org/freedesktop/DBus"
+#define PROPERTIES_INTERFACE    "org.freedesktop.DBus.Properties"
+
 const QString DBUS_NAME = "org.ukui.SettingsDaemon";
 const QString DBUS_PATH = "/org/ukui/SettingsDaemon";
 const QString MEDIAKEYS_DBUS_NAME = DBUS_NAME + ".MediaKeys";
 const QString MEDIAKEYS_DBUS_PATH = DBUS_PATH + "/MediaKeys";
 
-/* Number of media players supported.
- * Correlates to the number of elements in BUS_NAMES */
-const int NUM_BUS_NAMES = 16;
-
-/* Names to we want to watch */
-const QStringList busNames ={"org.mpris.MediaPlayer2.audacious",
-                             "org.mpris.MediaPlayer2.clementine",
-                             "org.mpris.MediaPlayer2.vlc",
-                             "org.mpris.MediaPlayer2.mpd",
-                             "org.mpris.MediaPlayer2.exaile",
-                             "org.mpris.MediaPlayer2.banshee",
-                             "org.mpris.MediaPlayer2.rhythmbox",
-                             "org.mpris.MediaPlayer2.pragha",
-                             "org.mpris.MediaPlayer2.quodlibet",
-                             "org.mpris.MediaPlayer2.guayadeque",
-                             "org.mpris.MediaPlayer2.amarok",
-                             "org.mpris.MediaPlayer2.nuvolaplayer",
-                             "org.mpris.MediaPlayer2.xbmc",
-                             "org.mpris.MediaPlayer2.xnoise",
-                             "org.mpris.MediaPlayer2.gmusicbrowser",
-                             "org.mpris.MediaPlayer2.spotify",
-                            };
-
 MprisManager* MprisManager::mMprisManager = nullptr;
 
 MprisManager::MprisManager(QObject *parent):QObject(parent)
 {
-
+    mConnection = NULL;
+    mCancellable = NULL;
+    mOwnerSubscription = 0;
+    mPropertiesSubscription = 0;
+    mActivePlayer = nullptr;
+    mActivity = 0;
 }
 
 MprisManager::~MprisManager()
@@ -67,25 +53,47 @@ MprisManager::~MprisManager()
 
 bool MprisManager::MprisManagerStart (GError           **error)
 {
-    QStringList list;
     QDBusConnection conn = QDBusConnection::sessionBus();
     QDBusMessage tmpMsg,response ;
 
-    mPlayerQuque = new QQueue<QString>();
-    mDbusWatcher = new QDBusServiceWatcher();
+    mConnection = g_bus_get_sync(G_BUS_TYPE_SESSION,NULL,error);
+    if(!mConnection)
+        return false;
+    mCancellable = g_cancellable_new();
 
-    mDbusWatcher->setWatchMode(QDBusServiceWatcher::WatchForRegistration |
-                               QDBusServiceWatcher::WatchForUnregistration);
+    mDbusWatcher = new QDBusServiceWatcher();
+    mDbusWatcher->setWatchMode(QDBusServiceWatcher::WatchForUnregistration);
     mDbusWatcher->setConnection(conn);
     mDbusInterface = new QDBusInterface(DBUS_NAME,MEDIAKEYS_DBUS_PATH,MEDIAKEYS_DBUS_NAME,
                                         conn);
 
    syslog (LOG_DEBUG,"Starting mpris manager");
 
-    /* Register all the names we wish to watch.*/
-    mDbusWatcher->setWatchedServices(busNames);
+    /** every org.mpris.MediaPlayer2.* name is watched through a single
+     *  arg0namespace match, so any player works without being listed here;
+     *  playback state is cached from PropertiesChanged, a key press never
+     *  waits for a player to answer
+     *
+     *  通过一条arg0namespace匹配规则监视所有org.mpris.MediaPlayer2.*名称，
+     *  任何播放器都无需预先列出；播放状态从PropertiesChanged缓存，
+     *  按键时不需要等待播放器应答
+     */
+    mOwnerSubscription = g_dbus_connection_signal_subscribe(mConnection,FREEDESKTOP_DBUS_NAME,
+                                                            FREEDESKTOP_DBUS_NAME,"NameOwnerChanged",
+                                                            FREEDESKTOP_DBUS_PATH,MPRIS_NAMESPACE,
+                                                            G_DBUS_SIGNAL_FLAGS_MATCH_ARG0_NAMESPACE,
+                                                            onNameOwnerChanged,this,NULL);
+    mPropertiesSubscription = g_dbus_connection_signal_subscribe(mConnection,NULL,
+                                                                 PROPERTIES_INTERFACE,"PropertiesChanged",
+                                                                 MPRIS_OBJECT_PATH,MPRIS_INTERFACE,
+                                                                 G_DBUS_SIGNAL_FLAGS_NONE,
+                                                                 onPropertiesChanged,this,NULL);
+    //players that were running before us 在本插件之前启动的播放器
+    g_dbus_connection_call(mConnection,FREEDESKTOP_DBUS_NAME,FREEDESKTOP_DBUS_PATH,
+                           FREEDESKTOP_DBUS_NAME,"ListNames",NULL,G_VARIANT_TYPE("(as)"),
+                           G_DBUS_CALL_FLAGS_NONE,-1,mCancellable,onListNames,NULL);
+
     mDbusWatcher->addWatchedService(DBUS_NAME);
-    connect(mDbusWatcher,SIGNAL(serviceRegistered(const QString&)),this,SLOT(serviceRegisteredSlot(const QString&)));
     connect(mDbusWatcher,SIGNAL(serviceUnregistered(const QString&)),this,SLOT(serviceUnregisteredSlot(const QString&)));
 
     if(!mDbusInterface->isValid()){
@@ -127,9 +135,20 @@ void MprisManager::MprisManagerStop()
     delete mDbusWatcher;
     mDbusWatcher = nullptr;
 
-    mPlayerQuque->clear();
-    delete mPlayerQuque;
-    mPlayerQuque = nullptr;
+    if(mCancellable){
+        g_cancellable_cancel(mCancellable);
+        g_clear_object(&mCancellable);
+    }
+    if(mConnection){
+        g_dbus_connection_signal_unsubscribe(mConnection,mOwnerSubscription);
+        g_dbus_connection_signal_unsubscribe(mConnection,mPropertiesSubscription);
+        mOwnerSubscription = mPropertiesSubscription = 0;
+        g_clear_object(&mConnection);
+    }
+
+    qDeleteAll(mPlayers);
+    mPlayers.clear();
+    mActivePlayer = nullptr;
 }
 
 MprisManager* MprisManager::MprisManagerNew()
@@ -139,57 +158,229 @@ MprisManager* MprisManager::MprisManagerNew()
     return mMprisManager;
 }
 
-/** Returns the name of the media player.
- * @name    if @name=="org.mpris.MediaPlayer2.vlc"
- * @return  then @return=="vlc"
+/**
+ * @brief MprisManager::playerAdded
+ *        a media player was just run, it becomes the most recently active one
+ *        一个媒体播放器刚刚启动，成为最近活跃的播放器
+ * @param name  for example: @name can be "org.mpris.MediaPlayer2.vlc"
+ * @param owner unique name of the player connection
+ */
+void MprisManager::playerAdded(const char *name,const char *owner)
+{
+    MprisPlayer *player;
+
+    //a player may own more than one name 一个播放器可能持有多个名称
+    if(mPlayers.contains(owner))
+        return;
+
+    syslog (LOG_DEBUG,"MPRIS Name Registered: %s\n", name);
+
+    player = new MprisPlayer;
+    player->name = name;
+    player->owner = owner;
+    player->status = "Stopped";
+    player->activity = ++mActivity;
+    mPlayers.insert(player->owner,player);
+
+    g_dbus_connection_call(mConnection,owner,MPRIS_OBJECT_PATH,PROPERTIES_INTERFACE,"Get",
+                           g_variant_new("(ss)",MPRIS_INTERFACE,"PlaybackStatus"),
+                           G_VARIANT_TYPE("(v)"),G_DBUS_CALL_FLAGS_NO_AUTO_START,-1,
+                           mCancellable,onGetPlaybackStatus,g_strdup(owner));
+    updateActivePlayer();
+}
+
+/**
+ * @brief MprisManager::playerRemoved
+ *        a media player quit running and should be removed from @mPlayers.
+ *        一个媒体播放器退出时应当从@mPlayers中移除
  */
-QString getPlayerName(const QString& name)
+void MprisManager::playerRemoved(const char *owner)
+{
+    MprisPlayer *player = mPlayers.take(owner);
+
+    if(!player)
+        return;
+
+    syslog (LOG_DEBUG,"MPRIS Name Unregistered: %s\n", player->name.toLatin1().data());
+    if(mActivePlayer == player)
+        mActivePlayer = nullptr;
+    delete player;
+    updateActivePlayer();
+}
+
+void MprisManager::playerStatusChanged(MprisPlayer *player,const char *status)
 {
-    QString ret_name=name.section(".",3,4);
-    return ret_name;
+    if(player->status == status)
+        return;
+
+    player->status = status;
+    //starting playback makes a player the most recently active 开始播放的播放器成为最近活跃的
+    if(player->status == "Playing")
+        player->activity = ++mActivity;
+    updateActivePlayer();
 }
 
-void MprisManager::serviceRegisteredSlot(const QString& service)
+/**
+ * @brief MprisManager::updateActivePlayer
+ *        pick the player that receives the media keys: the most recently
+ *        active playing one, otherwise the most recently active one.
+ *        only runs on bus events, key presses use @mActivePlayer directly
+ *        选择接收媒体按键的播放器：优先最近活跃的正在播放的播放器，
+ *        否则为最近活跃的播放器。只在总线事件时执行，按键时直接使用@mActivePlayer
+ */
+void MprisManager::updateActivePlayer()
 {
-    QString realPlayername;
+    MprisPlayer *best = nullptr;
 
-    syslog (LOG_DEBUG,"MPRIS Name Registered: %s\n", service.toLatin1().data());
+    for(MprisPlayer *player : mPlayers){
+        bool playing = player->status == "Playing";
 
-    if(DBUS_NAME == service){
+        if(!best){
+            best = player;
+            continue;
+        }
+        if(playing != (best->status == "Playing")){
+            if(playing)
+                best = player;
+            continue;
+        }
+        if(player->activity > best->activity)
+            best = player;
+    }
+    mActivePlayer = best;
+}
+
+void MprisManager::onNameOwnerChanged(GDBusConnection *connection,
+                                      const gchar     *sender,
+                                      const gchar     *path,
+                                      const gchar     *interface,
+                                      const gchar     *signal,
+                                      GVariant        *parameters,
+                                      gpointer         data)
+{
+    MprisManager *manager = (MprisManager *) data;
+    const gchar  *name,*oldOwner,*newOwner;
+    MprisPlayer  *player;
+
+    g_variant_get(parameters,"(&s&s&s)",&name,&oldOwner,&newOwner);
+
+    if(oldOwner[0]){
+        player = manager->mPlayers.value(oldOwner);
+        if(player && player->name == name)
+            manager->playerRemoved(oldOwner);
+    }
+    if(newOwner[0])
+        manager->playerAdded(name,newOwner);
+}
+
+void MprisManager::onPropertiesChanged(GDBusConnection *connection,
+                                       const gchar     *sender,
+                                       const gchar     *path,
+                                       const gchar     *interface,
+                                       const gchar     *signal,
+                                       GVariant        *parameters,
+                                       gpointer         data)
+{
+    MprisManager *manager = (MprisManager *) data;
+    MprisPlayer  *player;
+    GVariant     *changed;
+    const gchar  *status;
+
+    player = manager->mPlayers.value(sender);
+    if(!player)
+        return;
+
+    changed = g_variant_get_child_value(parameters,1);
+    if(g_variant_lookup(changed,"PlaybackStatus","&s",&status))
+        manager->playerStatusChanged(player,status);
+    g_variant_unref(changed);
+}
+
+void MprisManager::onListNames(GObject *source,GAsyncResult *res,gpointer data)
+{
+    GVariant     *result;
+    GVariantIter *iter;
+    const gchar  *name;
+
+    result = g_dbus_connection_call_finish(G_DBUS_CONNECTION(source),res,NULL);
+    if(!result)
+        return;
+
+    g_variant_get(result,"(as)",&iter);
+    while(g_variant_iter_loop(iter,"&s",&name)){
+        if(!g_str_has_prefix(name,MPRIS_NAMESPACE "."))
+            continue;
+        g_dbus_connection_call(mMprisManager->mConnection,FREEDESKTOP_DBUS_NAME,FREEDESKTOP_DBUS_PATH,
+                               FREEDESKTOP_DBUS_NAME,"GetNameOwner",g_variant_new("(s)",name),
+                               G_VARIANT_TYPE("(s)"),G_DBUS_CALL_FLAGS_NONE,-1,
+                               mMprisManager->mCancellable,onGetNameOwner,g_strdup(name));
+    }
+    g_variant_iter_free(iter);
+    g_variant_unref(result);
+}
+
+void MprisManager::onGetNameOwner(GObject *source,GAsyncResult *res,gpointer data)
+{
+    gchar       *name = (gchar *) data;
+    GVariant    *result;
+    const gchar *owner;
+
+    result = g_dbus_connection_call_finish(G_DBUS_CONNECTION(source),res,NULL);
+    if(result){
+        g_variant_get(result,"(&s)",&owner);
+        mMprisManager->playerAdded(name,owner);
+        g_variant_unref(result);
+    }
+    g_free(name);
+}
+
+void MprisManager::onGetPlaybackStatus(GObject *source,GAsyncResult *res,gpointer data)
+{
+    gchar       *owner = (gchar *) data;
+    GVariant    *result,*value;
+    MprisPlayer *player;
+
+    result = g_dbus_connection_call_finish(G_DBUS_CONNECTION(source),res,NULL);
+    if(result){
+        g_variant_get(result,"(v)",&value);
+        player = mMprisManager->mPlayers.value(owner);
+        if(player && g_variant_is_of_type(value,G_VARIANT_TYPE_STRING))
+            mMprisManager->playerStatusChanged(player,g_variant_get_string(value,NULL));
+        g_variant_unref(value);
+        g_variant_unref(result);
+    }
+    g_free(owner);
+}
+
+void MprisManager::onPlayerCall(GObject *source,GAsyncResult *res,gpointer data)
+{
+    GError   *error = NULL;
+    GVariant *result;
+
+    result = g_dbus_connection_call_finish(G_DBUS_CONNECTION(source),res,&error);
+    if(!result){
+        syslog(LOG_ERR,"error: %s",error->message);
+        g_error_free(error);
         return;
-    }else{
-        /* A media player was just run and should be
-         * added to the head of @mPlayerQuque.
-         */
-        realPlayername = getPlayerName(service);
-        mPlayerQuque->push_front(realPlayername);
     }
+    g_variant_unref(result);
 }
 
 /**
  * @brief MprisManager::serviceUnregisteredSlot
- *        if anyone dbus service that from @busNames quit,this func will be called.
- *        如果来自于@busNames的任意一个dbus服务关闭，则该函数被执行
+ *        org.ukui.SettingsDaemon quit, the media keys interface is gone
+ *        org.ukui.SettingsDaemon 退出，媒体按键接口随之失效
  * @param service
- *        for example: @service can be "org.mpris.MediaPlayer2.vlc"
  */
 void MprisManager::serviceUnregisteredSlot(const QString& service)
 {
-    QString realPlayername;
-    syslog (LOG_DEBUG,"MPRIS Name Unregistered: %s\n", service.toLatin1().data());
+    syslog (LOG_DEBUG,"Name Unregistered: %s\n", service.toLatin1().data());
 
     if(DBUS_NAME == service){
         if(nullptr != mDbusInterface){
             delete mDbusInterface;
             mDbusInterface = nullptr;
         }
-    }else{
-        /* A media player quit running and should be removed from @mPlayerQueue.
-         * 一个媒体播放器退出时应当从@mPlayerQueue中移除
-         */
-        realPlayername = getPlayerName(service);
-        if(mPlayerQuque->contains(realPlayername))
-            mPlayerQuque->removeOne(realPlayername);
     }
 }
 
@@ -204,13 +395,11 @@ void MprisManager::serviceUnregisteredSlot(const QString& service)
  */
 void MprisManager::keyPressed(QString application,QString operation)
 {
-    QString mprisKey = nullptr;
-    QString mprisHead,mprisName;
-    QDBusMessage playerMsg,response;
+    const char *mprisKey = NULL;
 
     if("UsdMpris" != application)
         return;
-    if(mPlayerQuque->isEmpty())
+    if(!mActivePlayer)
         return;
 
     if("Play" == operation)
@@ -224,19 +413,13 @@ void MprisManager::keyPressed(QString application,QString operation)
     else if("Stop" == operation)
         mprisKey = "Stop";
 
-    if(mprisKey.isNull())
+    if(!mprisKey)
        return;
 
-    mprisHead = mPlayerQuque->head();
-    mprisName = MPRIS_PREFIX + mprisHead;
-
-    /* create a dbus method call by QDBusMessage, the @mprisName is a member of @busNames
-     * 通过QDBusMessage的方式创建一个dbus方法调用，@mprisName 来自于 @busNames
+    /* the call is not waited for, the reply is only checked for errors
+     * 不等待调用返回，只检查应答中的错误
      */
-    playerMsg = QDBusMessage::createMethodCall(mprisName,MPRIS_OBJECT_PATH,MPRIS_INTERFACE,mprisKey);
-    response = QDBusConnection::sessionBus().call(playerMsg);
-    if(response.type() == QDBusMessage::ErrorMessage)
-        syslog(LOG_ERR,"error: %s",response.errorMessage().toLatin1().data());
+    g_dbus_connection_call(mConnection,mActivePlayer->owner.toLatin1().data(),MPRIS_OBJECT_PATH,
+                           MPRIS_INTERFACE,mprisKey,NULL,NULL,G_DBUS_CALL_FLAGS_NO_AUTO_START,-1,
+                           NULL,onPlayerCall,NULL);
 }
-
-
@@ -20,7 +20,7 @@
 #define MPRISMANAGER_H
 
 #include <QObject>
-#include <QQueue>
+#include <QHash>
 #include <QString>
 #include <QDBusServiceWatcher>
 #include <QDBusInterface>
@@ -35,6 +35,16 @@
 
 #include <gio/gio.h>        //for GError
 
+/** a running media player, keyed by its unique bus name
+ *  正在运行的媒体播放器，以唯一总线名索引
+ */
+typedef struct{
+    QString name;           //org.mpris.MediaPlayer2.vlc
+    QString owner;          //:1.42
+    QString status;         //cached PlaybackStatus: Playing, Paused, Stopped
+    quint64 activity;       //larger means more recently started or resumed
+}MprisPlayer;
+
 class MprisManager : public QObject{
     Q_OBJECT
 public:
@@ -47,8 +57,21 @@ private:
     MprisManager(QObject *parent = nullptr);
     MprisManager(const MprisManager&) = delete;
 
+    void playerAdded(const char *name,const char *owner);
+    void playerRemoved(const char *owner);
+    void playerStatusChanged(MprisPlayer *player,const char *status);
+    void updateActivePlayer();
+
+    static void onNameOwnerChanged(GDBusConnection*,const gchar*,const gchar*,const gchar*,
+                                   const gchar*,GVariant*,gpointer);
+    static void onPropertiesChanged(GDBusConnection*,const gchar*,const gchar*,const gchar*,
+                                    const gchar*,GVariant*,gpointer);
+    static void onListNames(GObject*,GAsyncResult*,gpointer);
+    static void onGetNameOwner(GObject*,GAsyncResult*,gpointer);
+    static void onGetPlaybackStatus(GObject*,GAsyncResult*,gpointer);
+    static void onPlayerCall(GObject*,GAsyncResult*,gpointer);
+
 private Q_SLOTS:
-    void serviceRegisteredSlot(const QString&);
     void serviceUnregisteredSlot(const QString&);
     void keyPressed(QString,QString);
 
@@ -56,7 +79,14 @@ private:
     static MprisManager   *mMprisManager;
     QDBusServiceWatcher   *mDbusWatcher;
     QDBusInterface        *mDbusInterface;
-    QQueue<QString>       *mPlayerQuque;
+
+    GDBusConnection       *mConnection;
+    GCancellable          *mCancellable;
+    guint                  mOwnerSubscription;
+    guint                  mPropertiesSubscription;
+    QHash<QString,MprisPlayer*> mPlayers;   //unique name -> player
+    MprisPlayer           *mActivePlayer;   //receives the media keys
+    quint64                mActivity;
 };
 
 #endif /* MPRISMANAGER_H */
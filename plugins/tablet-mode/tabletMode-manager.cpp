@@ -37,6 +37,8 @@ TabletModeManager::TabletModeManager()
 {
     mSensor = new QOrientationSensor(this);
     mXrandrSettings = new QGSettings(SETTINGS_XRANDR_SCHEMAS);
+    /* 传感器每次读数都会写入旋转方向，只有方向改变时才真正写入 */
+    mXrandrSettings->coalesce();
     mTableSettings  = new QGSettings(SETTINGS_TABLET_SCHEMAS);
 }
 
@@ -0,0 +1,210 @@
+/* -*- Mode: C++; indent-tabs-mode: nil; tab-width: 4 -*-
+ * -*- coding: utf-8 -*-
+ *
+ * Copyright (C) 2020 KylinSoft Co., Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <QDebug>
+
+#include <algorithm>
+
+#include "layout-solver.h"
+
+/* 输出在屏幕上占用的宽度，竖屏时取模式的高 */
+static int
+logical_width (const SolverOutput &output)
+{
+    return output.portrait ? output.height : output.width;
+}
+
+/* 面积大的在前，面积相同时刷新率高的在前 */
+static bool
+mode_before (const SolverMode &a, const SolverMode &b)
+{
+    int area_a = a.width * a.height;
+    int area_b = b.width * b.height;
+
+    if (area_a != area_b)
+        return area_a > area_b;
+    return a.rate > b.rate;
+}
+
+/**
+ * 已打开的输出按原来的左右顺序从 x = 0 起紧密排列，返回下一个输出的 x。
+ * 全部重叠在同一位置时是镜像布局，保持不动
+ */
+int LayoutSolver::placeKeptOutputs(SolverScreen &screen, QList<int> &kept)
+{
+    QList<SolverOutput> &outputs = screen.outputs;
+    bool clone = true;
+    int  x = 0;
+
+    std::stable_sort (kept.begin (), kept.end (), [&outputs] (int a, int b) {
+        return outputs[a].x < outputs[b].x;
+    });
+
+    for (int i = 1; i < kept.size (); i++) {
+        const SolverOutput &output = outputs[kept[i]];
+
+        if (output.x != outputs[kept[0]].x || output.y != outputs[kept[0]].y)
+            clone = false;
+    }
+
+    for (int index : kept) {
+        SolverOutput &output = outputs[index];
+
+        if (clone && kept.size () > 1) {
+            x = qMax (x, output.x + logical_width (output));
+        } else {
+            output.x = x;
+            output.y = 0;
+            x += logical_width (output);
+        }
+    }
+    return x;
+}
+
+/* 依次尝试首选模式和其余由大到小的模式，返回第一个在 x 处放得下的下标，没有时返回 -1 */
+int LayoutSolver::pickMode(const SolverScreen &screen, const SolverOutput &output, int x)
+{
+    QList<int> candidates;
+
+    for (int i = 0; i < output.modes.size (); i++) {
+        if (i != output.preferred)
+            candidates.append (i);
+    }
+    std::stable_sort (candidates.begin (), candidates.end (), [&output] (int a, int b) {
+        return mode_before (output.modes[a], output.modes[b]);
+    });
+    if (output.preferred >= 0 && output.preferred < output.modes.size ())
+        candidates.prepend (output.preferred);
+
+    for (int index : candidates) {
+        const SolverMode &mode = output.modes[index];
+
+        if (x + mode.width <= screen.maxWidth && mode.height <= screen.maxHeight)
+            return index;
+    }
+    return -1;
+}
+
+/**
+ * 为新打开的输出找一个 CRTC（二分图匹配的增广路）。
+ * owner 记录 CRTC 被哪个输出占用，-1 表示被已打开的输出占用，不参与调整
+ */
+bool LayoutSolver::assignCrtc(const SolverScreen &screen, int index,
+                              QHash<int, int> &owner, QSet<int> &visited)
+{
+    for (int crtc : screen.outputs[index].possibleCrtcs) {
+        if (visited.contains (crtc))
+            continue;
+        visited.insert (crtc);
+
+        if (!owner.contains (crtc)) {
+            owner.insert (crtc, index);
+            return true;
+        }
+
+        int holder = owner.value (crtc);
+        if (holder >= 0 && assignCrtc (screen, holder, owner, visited)) {
+            owner.insert (crtc, index);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool LayoutSolver::solve(SolverScreen &screen)
+{
+    QList<SolverOutput> &outputs = screen.outputs;
+    QHash<int, int> owner;
+    QList<int>      kept, added;
+    bool            any_active;
+    int             x;
+
+    for (int i = 0; i < outputs.size (); i++) {
+        SolverOutput &output = outputs[i];
+
+        output.turnedOn = false;
+        if (!output.connected) {
+            output.active = false;
+            continue;
+        }
+
+        if (output.active) {
+            /* 已打开的输出保留自己的 CRTC */
+            if (output.crtc >= 0)
+                owner.insert (output.crtc, -1);
+            kept.append (i);
+        } else {
+            added.append (i);
+        }
+    }
+
+    x = placeKeptOutputs (screen, kept);
+    any_active = !kept.isEmpty ();
+
+    for (int index : added) {
+        SolverOutput &output = outputs[index];
+        QSet<int>     visited;
+        int           mode;
+
+        mode = pickMode (screen, output, x);
+        if (mode < 0) {
+            qDebug("no mode of %s fits the framebuffer", qPrintable (output.name));
+            continue;
+        }
+
+        if (!assignCrtc (screen, index, owner, visited)) {
+            qDebug("no free CRTC for %s", qPrintable (output.name));
+            continue;
+        }
+
+        output.active = true;
+        output.turnedOn = true;
+        output.portrait = false;
+        output.x = x;
+        output.y = 0;
+        output.width = output.modes[mode].width;
+        output.height = output.modes[mode].height;
+        output.rate = output.modes[mode].rate;
+        x += output.width;
+        any_active = true;
+    }
+
+    return any_active;
+}
+
+/* 新打开的输出从左到右排列，最后一个在最右侧，关闭它不影响其他输出的位置 */
+bool LayoutSolver::turnOffNewest(SolverScreen &screen)
+{
+    QList<SolverOutput> &outputs = screen.outputs;
+
+    for (int i = outputs.size () - 1; i >= 0; i--) {
+        SolverOutput &output = outputs[i];
+
+        if (!output.turnedOn)
+            continue;
+
+        output.active = false;
+        output.turnedOn = false;
+        for (const SolverOutput &other : outputs) {
+            if (other.active)
+                return true;
+        }
+        return false;
+    }
+    return false;
+}
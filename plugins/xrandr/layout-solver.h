@@ -0,0 +1,93 @@
+/* -*- Mode: C++; indent-tabs-mode: nil; tab-width: 4 -*-
+ * -*- coding: utf-8 -*-
+ *
+ * Copyright (C) 2020 KylinSoft Co., Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef LAYOUTSOLVER_H
+#define LAYOUTSOLVER_H
+
+#include <QHash>
+#include <QList>
+#include <QSet>
+#include <QString>
+
+/* 输出支持的一个模式 */
+struct SolverMode
+{
+    int width;
+    int height;
+    int rate;
+};
+
+/**
+ * 求解用的输出描述，由 MateRR 的输出和当前配置转换而来。
+ * active/x/y/width/height/rate 输入时是当前状态，求解后是新的布局；
+ * width/height 是模式的大小，portrait 为真时在屏幕上占用的宽高互换
+ */
+struct SolverOutput
+{
+    QString           name;
+    bool              connected = false;
+    bool              active = false;
+    int               x = 0;
+    int               y = 0;
+    int               width = 0;
+    int               height = 0;
+    int               rate = 0;
+    bool              portrait = false;
+    bool              turnedOn = false;    /* 求解后新打开的输出，旋转设为 0 */
+    int               crtc = -1;           /* 当前占用的 CRTC，-1 表示没有；只作为输入 */
+    QList<SolverMode> modes;
+    int               preferred = -1;      /* 首选模式在 modes 中的下标 */
+    QList<int>        possibleCrtcs;
+};
+
+struct SolverScreen
+{
+    int                 maxWidth = 0;
+    int                 maxHeight = 0;
+    QList<SolverOutput> outputs;
+};
+
+/**
+ * 显示器插拔时的自动布局
+ * 在进程内按屏幕的帧缓冲区大小限制和各输出可用的 CRTC、模式计算布局，
+ * 不再逐个关闭新输出、反复询问配置是否可用。
+ *
+ * 已打开的输出保持原来的模式、旋转和 CRTC，按原来的左右顺序排列；
+ * 新连接的输出依次放在右侧，优先使用首选模式，放不下时换用较小的模式，
+ * 没有合适的模式或空闲的 CRTC 时保持关闭。
+ *
+ * CRTC 的匹配只用来判断能否同时打开这些输出，结果不写回：
+ * 应用配置时由 MateRR 重新分配 CRTC。
+ */
+class LayoutSolver
+{
+public:
+    /* 把布局写回 screen；没有输出可以打开时返回 false */
+    static bool solve(SolverScreen &screen);
+
+    /* 应用失败时关闭最后一个新打开的输出；没有可关闭的或已无输出打开时返回 false */
+    static bool turnOffNewest(SolverScreen &screen);
+
+private:
+    static int  placeKeptOutputs(SolverScreen &screen, QList<int> &kept);
+    static int  pickMode(const SolverScreen &screen, const SolverOutput &output, int x);
+    static bool assignCrtc(const SolverScreen &screen, int index,
+                           QHash<int, int> &owner, QSet<int> &visited);
+};
+
+#endif // LAYOUTSOLVER_H
@@ -0,0 +1,230 @@
+/* -*- Mode: C++; indent-tabs-mode: nil; tab-width: 4 -*-
+ * -*- coding: utf-8 -*-
+ *
+ * Copyright (C) 2020 KylinSoft Co., Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <QDebug>
+#include <QStringList>
+#include <string.h>
+
+#include "layout-store.h"
+
+#define LAYOUT_STORE_DIR        "ukui-settings-daemon"
+#define LAYOUT_STORE_FILE       "display-layouts"
+
+/* 每个输出一行中各项的位置 */
+enum {
+    LAYOUT_ACTIVE,
+    LAYOUT_X,
+    LAYOUT_Y,
+    LAYOUT_WIDTH,
+    LAYOUT_HEIGHT,
+    LAYOUT_RATE,
+    LAYOUT_ROTATION,
+    LAYOUT_PRIMARY,
+    LAYOUT_N_ITEMS
+};
+
+LayoutStore::LayoutStore()
+{
+    mPath = g_build_filename (g_get_user_config_dir (), LAYOUT_STORE_DIR,
+                              LAYOUT_STORE_FILE, NULL);
+    mFile = g_key_file_new ();
+    /* 文件不存在时从空记录开始 */
+    g_key_file_load_from_file (mFile, mPath, G_KEY_FILE_NONE, NULL);
+}
+
+LayoutStore::~LayoutStore()
+{
+    g_key_file_free (mFile);
+    g_free (mPath);
+}
+
+static gint
+compare_output_name (gconstpointer a, gconstpointer b)
+{
+    return g_strcmp0 (mate_rr_output_get_name (*(MateRROutput **) a),
+                      mate_rr_output_get_name (*(MateRROutput **) b));
+}
+
+QString LayoutStore::fingerprint(MateRRScreen *screen)
+{
+    MateRROutput **outputs = mate_rr_screen_list_outputs (screen);
+    GPtrArray     *connected = g_ptr_array_new ();
+    GChecksum     *checksum;
+    QString        result;
+    guint          i;
+
+    for (i = 0; outputs && outputs[i] != NULL; i++) {
+        if (mate_rr_output_is_connected (outputs[i]))
+            g_ptr_array_add (connected, outputs[i]);
+    }
+    /* 与输出的枚举顺序无关 */
+    g_ptr_array_sort (connected, compare_output_name);
+
+    if (connected->len > 0) {
+        checksum = g_checksum_new (G_CHECKSUM_SHA1);
+        for (i = 0; i < connected->len; i++) {
+            MateRROutput *output = (MateRROutput *) g_ptr_array_index (connected, i);
+            const char   *name = mate_rr_output_get_name (output);
+            const guint8 *edid;
+            gsize         size = 0;
+
+            edid = mate_rr_output_get_edid_data (output, &size);
+            g_checksum_update (checksum, (const guchar *) name, strlen (name) + 1);
+            if (edid && size > 0)
+                g_checksum_update (checksum, edid, size);
+        }
+        result = QString::fromLatin1 (g_checksum_get_string (checksum));
+        g_checksum_free (checksum);
+    }
+    g_ptr_array_free (connected, TRUE);
+
+    return result;
+}
+
+void LayoutStore::remember(const QString &fingerprint, MateRRConfig *config)
+{
+    MateRROutputInfo **outputs = mate_rr_config_get_outputs (config);
+    QByteArray group = fingerprint.toLatin1 ();
+    QStringList names;
+    gchar    **keys;
+    bool       changed = false;
+    int        i;
+
+    if (group.isEmpty())
+        return;
+
+    for (i = 0; outputs[i] != NULL; i++) {
+        MateRROutputInfo *info = outputs[i];
+        const char *name = mate_rr_output_info_get_name (info);
+        gint   values[LAYOUT_N_ITEMS];
+        gint  *stored;
+        gsize  length = 0;
+        int    x = 0, y = 0, width = 0, height = 0;
+
+        if (!mate_rr_output_info_is_connected (info))
+            continue;
+
+        mate_rr_output_info_get_geometry (info, &x, &y, &width, &height);
+        values[LAYOUT_ACTIVE]   = mate_rr_output_info_is_active (info);
+        values[LAYOUT_X]        = x;
+        values[LAYOUT_Y]        = y;
+        values[LAYOUT_WIDTH]    = width;
+        values[LAYOUT_HEIGHT]   = height;
+        values[LAYOUT_RATE]     = mate_rr_output_info_get_refresh_rate (info);
+        values[LAYOUT_ROTATION] = mate_rr_output_info_get_rotation (info);
+        values[LAYOUT_PRIMARY]  = mate_rr_output_info_get_primary (info);
+        names << QString::fromLatin1 (name);
+
+        stored = g_key_file_get_integer_list (mFile, group.constData(), name, &length, NULL);
+        if (stored == NULL || length != LAYOUT_N_ITEMS ||
+            memcmp (stored, values, sizeof (values)) != 0) {
+            g_key_file_set_integer_list (mFile, group.constData(), name, values, LAYOUT_N_ITEMS);
+            changed = true;
+        }
+        g_free (stored);
+    }
+
+    /* 记录中已不属于这组显示器的输出 */
+    keys = g_key_file_get_keys (mFile, group.constData(), NULL, NULL);
+    for (i = 0; keys && keys[i] != NULL; i++) {
+        if (!names.contains (QString::fromLatin1 (keys[i]))) {
+            g_key_file_remove_key (mFile, group.constData(), keys[i], NULL);
+            changed = true;
+        }
+    }
+    g_strfreev (keys);
+
+    if (changed)
+        save();
+}
+
+bool LayoutStore::restore(const QString &fingerprint, MateRRConfig *config)
+{
+    MateRROutputInfo **outputs = mate_rr_config_get_outputs (config);
+    QByteArray group = fingerprint.toLatin1 ();
+    bool       any_active = false;
+    int        i;
+
+    if (group.isEmpty() || !g_key_file_has_group (mFile, group.constData()))
+        return false;
+
+    /* 先检查记录覆盖了所有已连接的输出，再修改 config */
+    for (i = 0; outputs[i] != NULL; i++) {
+        MateRROutputInfo *info = outputs[i];
+        gint  *values;
+        gsize  length = 0;
+
+        if (!mate_rr_output_info_is_connected (info))
+            continue;
+        values = g_key_file_get_integer_list (mFile, group.constData(),
+                                              mate_rr_output_info_get_name (info),
+                                              &length, NULL);
+        if (values == NULL || length != LAYOUT_N_ITEMS) {
+            g_free (values);
+            return false;
+        }
+        any_active |= values[LAYOUT_ACTIVE] != 0;
+        g_free (values);
+    }
+    if (!any_active)
+        return false;
+
+    for (i = 0; outputs[i] != NULL; i++) {
+        MateRROutputInfo *info = outputs[i];
+        gint  *values;
+
+        if (!mate_rr_output_info_is_connected (info)) {
+            mate_rr_output_info_set_active (info, FALSE);
+            continue;
+        }
+        values = g_key_file_get_integer_list (mFile, group.constData(),
+                                              mate_rr_output_info_get_name (info),
+                                              NULL, NULL);
+        mate_rr_output_info_set_active (info, values[LAYOUT_ACTIVE]);
+        if (values[LAYOUT_ACTIVE]) {
+            mate_rr_output_info_set_geometry (info, values[LAYOUT_X], values[LAYOUT_Y],
+                                              values[LAYOUT_WIDTH], values[LAYOUT_HEIGHT]);
+            mate_rr_output_info_set_refresh_rate (info, values[LAYOUT_RATE]);
+            mate_rr_output_info_set_rotation (info, (MateRRRotation) values[LAYOUT_ROTATION]);
+        }
+        mate_rr_output_info_set_primary (info, values[LAYOUT_PRIMARY]);
+        g_free (values);
+    }
+    return true;
+}
+
+void LayoutStore::forget(const QString &fingerprint)
+{
+    QByteArray group = fingerprint.toLatin1 ();
+
+    if (g_key_file_remove_group (mFile, group.constData(), NULL))
+        save();
+}
+
+void LayoutStore::save()
+{
+    GError *error = NULL;
+    gchar  *dir = g_path_get_dirname (mPath);
+
+    g_mkdir_with_parents (dir, 0700);
+    if (!g_key_file_save_to_file (mFile, mPath, &error)) {
+        qWarning("Could not save display layouts: %s", error->message);
+        g_error_free (error);
+    }
+    g_free (dir);
+}
@@ -0,0 +1,64 @@
+/* -*- Mode: C++; indent-tabs-mode: nil; tab-width: 4 -*-
+ * -*- coding: utf-8 -*-
+ *
+ * Copyright (C) 2020 KylinSoft Co., Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef LAYOUTSTORE_H
+#define LAYOUTSTORE_H
+
+#include <QString>
+#include <glib.h>
+
+extern "C" {
+#define MATE_DESKTOP_USE_UNSTABLE_API
+#include <libmate-desktop/mate-rr.h>
+#include <libmate-desktop/mate-rr-config.h>
+}
+
+/**
+ * 显示布局记录
+ * 以已连接输出的连接器名和 EDID 的摘要为键，记录该组显示器最近一次
+ * 成功应用的布局。再次连接同一组显示器时直接取出应用，
+ * 不再逐个关闭输出试探可用的配置，也不解析 monitors.xml。
+ *
+ * 记录保存在用户配置目录下的一个 key file 中，每组显示器一节，
+ * 每个输出一行：active;x;y;width;height;rate;rotation;primary
+ */
+class LayoutStore
+{
+public:
+    LayoutStore();
+    ~LayoutStore();
+
+    /* 当前已连接显示器的指纹，没有已连接的输出时为空 */
+    static QString fingerprint(MateRRScreen *screen);
+
+    /* 记录 config 中已连接输出的布局，与已有记录相同时不写文件 */
+    void remember(const QString &fingerprint, MateRRConfig *config);
+    /* 把记录的布局写入 config；没有记录或输出与记录不符时返回 false */
+    bool restore(const QString &fingerprint, MateRRConfig *config);
+    /* 记录的布局应用失败时删除 */
+    void forget(const QString &fingerprint);
+
+private:
+    void save();
+
+private:
+    GKeyFile *mFile;
+    char     *mPath;
+};
+
+#endif // LAYOUTSTORE_H
@@ -20,7 +20,12 @@
 #include <QApplication>
 #include <QMessageBox>
 #include <QProcess>
+#include <QSet>
+#include <string.h>
+#include <gdk/gdkx.h>
 #include "xrandr-manager.h"
+#include "ukui-settings-pool.h"
+#include "ukui-display-coordinator.h"
 
 #define SETTINGS_XRANDR_SCHEMAS     "org.ukui.SettingsDaemon.plugins.xrandr"
 #define XRANDR_ROTATION_KEY         "xrandr-rotations"
@@ -30,13 +35,6 @@
 
 #define MAX_SIZE_MATCH_DIFF         0.05
 
-typedef struct
-{
-    unsigned char *input_node;
-    XIDeviceInfo dev_info;
-
-}TsInfo;
-
 
 XrandrManager *XrandrManager::mXrandrManager = nullptr;
 
@@ -44,6 +42,14 @@ XrandrManager::XrandrManager()
 {
     time = new QTimer(this);
     mXrandrSetting = new QGSettings(SETTINGS_XRANDR_SCHEMAS);
+    mScreen = nullptr;
+    mUdevClient = nullptr;
+    mTouchDevicesValid = false;
+    mTouchTimer = new QTimer(this);
+    mTouchTimer->setSingleShot(true);
+    mTouchTimer->setInterval(1000);
+    connect(mTouchTimer, SIGNAL(timeout()), this, SLOT(SetTouchscreenCursorRotation()));
+    mLayouts = new LayoutStore;
 }
 
 XrandrManager::~XrandrManager()
@@ -57,6 +63,9 @@ XrandrManager::~XrandrManager()
 
     if(mXrandrSetting)
         delete mXrandrSetting;
+    if (mUdevClient)
+        g_object_unref (mUdevClient);
+    delete mLayouts;
 }
 
 XrandrManager* XrandrManager::XrandrManagerNew()
@@ -79,6 +88,7 @@ bool XrandrManager::XrandrManagerStart()
 void XrandrManager::XrandrManagerStop()
 {
     qDebug("Xrandr Manager Stop");
+    DisplayCoordinator::removeStage (DISPLAY_STAGE_LAYOUT, LayoutStage, this);
 }
 
 
@@ -213,111 +223,113 @@ bool XrandrManager::SetScreenSize(Display  *dpy, Window root, int width, int hei
     return true;
 }
 
-/**
- * @name AutoConfigureOutputs();
- * @brief 自动配置输出,在进行硬件HDMI屏幕插拔时
- */
-void XrandrManager::AutoConfigureOutputs (XrandrManager *manager,
-                                          unsigned int timestamp)
+/* 把屏幕的限制、各输出的模式和 CRTC 以及 config 中的当前状态转换成求解用的描述 */
+static void
+solver_screen_from_config (MateRRScreen *screen, MateRRConfig *config, SolverScreen *result)
 {
-    int i, x;
-    GList *l;
-    GList *just_turned_on;
-    MateRRConfig *config;
-    MateRROutputInfo **outputs;
-    gboolean applicable;
+    MateRROutputInfo **outputs = mate_rr_config_get_outputs (config);
+    int min_width, min_height;
+    int i, j;
 
-    config = mate_rr_config_new_current (manager->mScreen, NULL);
-    just_turned_on = NULL;
-    outputs = mate_rr_config_get_outputs (config);
+    mate_rr_screen_get_ranges (screen, &min_width, &result->maxWidth,
+                               &min_height, &result->maxHeight);
 
     for (i = 0; outputs[i] != NULL; i++) {
-        MateRROutputInfo *output = outputs[i];
-
-        if (mate_rr_output_info_is_connected (output) && !mate_rr_output_info_is_active (output)) {
-                mate_rr_output_info_set_active (output, TRUE);
-                mate_rr_output_info_set_rotation (output, MATE_RR_ROTATION_0);
-                just_turned_on = g_list_prepend (just_turned_on, GINT_TO_POINTER (i));
-        } else if (!mate_rr_output_info_is_connected (output) && mate_rr_output_info_is_active (output))
-                mate_rr_output_info_set_active (output, FALSE);
+        MateRROutputInfo *info = outputs[i];
+        MateRROutput     *output;
+        SolverOutput      item;
+
+        output = mate_rr_screen_get_output_by_name (screen, mate_rr_output_info_get_name (info));
+        item.name = mate_rr_output_info_get_name (info);
+        item.connected = output && mate_rr_output_info_is_connected (info);
+        item.active = mate_rr_output_info_is_active (info);
+        mate_rr_output_info_get_geometry (info, &item.x, &item.y, &item.width, &item.height);
+        item.rate = mate_rr_output_info_get_refresh_rate (info);
+        item.portrait = (mate_rr_output_info_get_rotation (info) &
+                         (MATE_RR_ROTATION_90 | MATE_RR_ROTATION_270)) != 0;
+
+        if (output) {
+            MateRRMode  *preferred = mate_rr_output_get_preferred_mode (output);
+            MateRRMode **modes = mate_rr_output_list_modes (output);
+            MateRRCrtc **crtcs = mate_rr_output_get_possible_crtcs (output);
+            MateRRCrtc  *crtc = mate_rr_output_get_crtc (output);
+
+            for (j = 0; modes && modes[j] != NULL; j++) {
+                SolverMode mode;
+
+                mode.width = mate_rr_mode_get_width (modes[j]);
+                mode.height = mate_rr_mode_get_height (modes[j]);
+                mode.rate = mate_rr_mode_get_freq (modes[j]);
+                if (modes[j] == preferred)
+                    item.preferred = item.modes.size ();
+                item.modes.append (mode);
+            }
+            for (j = 0; crtcs && crtcs[j] != NULL; j++)
+                item.possibleCrtcs.append (mate_rr_crtc_get_id (crtcs[j]));
+            if (crtc)
+                item.crtc = mate_rr_crtc_get_id (crtc);
+        }
+        result->outputs.append (item);
     }
+}
 
-    /* Now, lay out the outputs from left to right.  Put first the outputs
-     * which remained on; put last the outputs that were newly turned on.
-     * 现在，从左到右布置输出。 首先整理目前存在的输出, 最后放置新打开的输出。
-     */
-    x = 0;
-
-    /* First, outputs that remained on
-     * 首先，输出保持不变
-     */
-    for (i = 0; outputs[i] != NULL; i++) {
-        MateRROutputInfo *output = outputs[i];
-
-        if (g_list_find (just_turned_on, GINT_TO_POINTER (i)))
-                continue;
-
-        if (mate_rr_output_info_is_active (output)) {
-            int width=0, height=0;
-            char *name;
-
-            g_assert (mate_rr_output_info_is_connected (output));
-            name = mate_rr_output_info_get_name(output);
+/* 把求解结果写回 config，输出的顺序与 solver_screen_from_config 一致 */
+static void
+solver_screen_apply (const SolverScreen &screen, MateRRConfig *config)
+{
+    MateRROutputInfo **outputs = mate_rr_config_get_outputs (config);
+    int i;
 
-            mate_rr_output_info_get_geometry (output, NULL, NULL, &width, &height);
-            mate_rr_output_info_set_geometry (output, x, 0, width, height);
+    for (i = 0; outputs[i] != NULL && i < screen.outputs.size (); i++) {
+        MateRROutputInfo   *info = outputs[i];
+        const SolverOutput &output = screen.outputs[i];
 
-            x += width;
+        if (!output.active) {
+            mate_rr_output_info_set_active (info, FALSE);
+            continue;
         }
+
+        mate_rr_output_info_set_active (info, TRUE);
+        if (output.turnedOn)
+            mate_rr_output_info_set_rotation (info, MATE_RR_ROTATION_0);
+        mate_rr_output_info_set_geometry (info, output.x, output.y, output.width, output.height);
+        mate_rr_output_info_set_refresh_rate (info, output.rate);
     }
+}
 
-    /* Second, outputs that were newly-turned on
-     * 第二，新打开的输出
-     */
-    for (l = just_turned_on; l; l = l->next) {
-        MateRROutputInfo *output;
-        int width=0, height=0;
-
-        i = GPOINTER_TO_INT (l->data);
-        output = outputs[i];
-        g_assert (mate_rr_output_info_is_active (output) && mate_rr_output_info_is_connected (output));
-
-        /* since the output was off, use its preferred width/height (it doesn't have a real width/height yet) */
-        width = mate_rr_output_info_get_preferred_width (output);
-        height = mate_rr_output_info_get_preferred_height (output);
-
-        mate_rr_output_info_set_geometry (output, x, 0, width, height);
-        x += width;
-    }
-
-    /* Check if we have a large enough framebuffer size.  If not, turn off
-     * outputs from right to left until we reach a usable size.
-     * 检查我们是否有足够大的帧缓冲区大小。如果没有，从右到左关闭输出，直到达到可用大小为止。
-     */
-    just_turned_on = g_list_reverse (just_turned_on); /* now the outputs here are from right to left */
-    l = just_turned_on;
-    while (1) {
-        MateRROutputInfo *output;
-        applicable = mate_rr_config_applicable (config, manager->mScreen, NULL);
-        if (applicable)
-                break;
-        if (l) {
-            i = GPOINTER_TO_INT (l->data);
-            l = l->next;
+/**
+ * @name AutoConfigureOutputs();
+ * @brief 自动配置输出,在进行硬件HDMI屏幕插拔时
+ * 布局在进程内按屏幕的限制一次算出；应用失败时依次关闭最新打开的输出再试
+ */
+bool XrandrManager::AutoConfigureOutputs (XrandrManager *manager,
+                                          unsigned int timestamp)
+{
+    MateRRConfig *config;
+    GError       *error = NULL;
+    SolverScreen  screen;
+    bool          success = false;
 
-            output = outputs[i];
-            mate_rr_output_info_set_active (output, FALSE);
-        } else
-            break;
+    config = mate_rr_config_new_current (manager->mScreen, NULL);
+    if (!config)
+        return false;
+
+    solver_screen_from_config (manager->mScreen, config, &screen);
+    if (!LayoutSolver::solve (screen)) {
+        g_object_unref (config);
+        return false;
     }
-    /* Apply the configuration!
-     * 应用配置
-     */
-    if (applicable)
-        mate_rr_config_apply_with_time (config, manager->mScreen, timestamp, NULL);
 
-    g_list_free (just_turned_on);
+    do {
+        solver_screen_apply (screen, config);
+        success = mate_rr_config_apply_with_time (config, manager->mScreen, timestamp, &error);
+        if (!success) {
+            qWarning("Could not apply automatic layout: %s", error ? error->message : "");
+            g_clear_error (&error);
+        }
+    } while (!success && LayoutSolver::turnOffNewest (screen));
     g_object_unref (config);
+    return success;
 }
 
 /*查找触摸屏设备ID*/
@@ -346,63 +358,55 @@ find_touchscreen_device(Display* display, XIDeviceInfo *dev)
     return false;
 }
 
-/* Get device node for gudev
-   node like "/dev/input/event6"
- */
-unsigned char *
-getDeviceNode (XIDeviceInfo devinfo)
+/* 设备节点，如 "/dev/input/event6"，用于在 udev 中查询设备 */
+static QByteArray
+get_device_node (Display *dpy, int deviceid)
 {
     Atom  prop;
     Atom act_type;
     int  act_format;
     unsigned long nitems, bytes_after;
-    unsigned char *data;
+    unsigned char *data = NULL;
+    QByteArray node;
 
-
-    prop = XInternAtom(QX11Info::display(), XI_PROP_DEVICE_NODE, False);
+    prop = XInternAtom(dpy, XI_PROP_DEVICE_NODE, True);
     if (!prop)
-        return NULL;
-
-
-    if (XIGetProperty(QX11Info::display(), devinfo.deviceid, prop, 0, 1000, False,
-                      AnyPropertyType, &act_type, &act_format, &nitems, &bytes_after, &data) == Success)
-    {
-        return data;
-    }
-
-    XFree(data);
-    return NULL;
+        return node;
+
+    if (XIGetProperty(dpy, deviceid, prop, 0, 1000, False,
+                      AnyPropertyType, &act_type, &act_format, &nitems, &bytes_after, &data) == Success &&
+        act_format == 8 && data)
+        node = QByteArray ((const char *) data, nitems);
+    if (data)
+        XFree(data);
+    return node;
 }
 
-/* Get touchscreen info */
-GList *
-getTouchscreen(Display* display)
+/* 设备当前的坐标变换矩阵；XI2 属性中 32 位的项按 32 位返回 */
+static bool
+get_device_matrix (Display *dpy, int deviceid, float matrix[9])
 {
-    gint n_devices;
-    XIDeviceInfo *devs_info;
-    //XIDeviceInfo *info;
-    int i;
-    GList *ts_devs = NULL;
-    Display *dpy = QX11Info::display();
-    devs_info = XIQueryDevice(dpy, XIAllDevices, &n_devices);
+    Atom  prop, prop_float;
+    Atom act_type;
+    int  act_format;
+    unsigned long nitems, bytes_after;
+    unsigned char *data = NULL;
+    bool  ret = false;
 
-    for (i = 0; i < n_devices; i ++)
-    {
-        if (find_touchscreen_device(dpy, &devs_info[i]))
-        {
-           unsigned char *node;
-           TsInfo *ts_info = g_new(TsInfo, 1);
-           node = getDeviceNode (devs_info[i]);
-
-           if (node)
-           {
-               ts_info->input_node = node;
-               ts_info->dev_info = devs_info[i];
-               ts_devs = g_list_append (ts_devs, ts_info);
-           }
-        }
+    prop = XInternAtom(dpy, "Coordinate Transformation Matrix", True);
+    prop_float = XInternAtom(dpy, "FLOAT", True);
+    if (!prop || !prop_float)
+        return false;
+
+    if (XIGetProperty(dpy, deviceid, prop, 0, 9, False,
+                      prop_float, &act_type, &act_format, &nitems, &bytes_after, &data) == Success &&
+        act_type == prop_float && act_format == 32 && nitems == 9 && data) {
+        memcpy (matrix, data, 9 * sizeof (float));
+        ret = true;
     }
-    return ts_devs;
+    if (data)
+        XFree(data);
+    return ret;
 }
 
 bool checkMatch(int output_width,  int output_height,
@@ -413,27 +417,12 @@ bool checkMatch(int output_width,  int output_height,
     w_diff = ABS (1 - ((double) output_width / input_width));
     h_diff = ABS (1 - ((double) output_height / input_height));
 
-    printf("w_diff is %f, h_diff is %f\n", w_diff, h_diff);
-
     if (w_diff < MAX_SIZE_MATCH_DIFF && h_diff < MAX_SIZE_MATCH_DIFF)
         return true;
     else
         return false;
 }
 
-/* Here to run command xinput
-   更新触摸屏触点位置
-*/
-void doAction (char *input_name, char *output_name)
-{
-    char buff[100];
-    sprintf(buff, "xinput --map-to-output \"%s\" \"%s\"", input_name, output_name);
-
-    printf("buff is %s\n", buff);
-
-    QProcess::execute(buff);
-}
-
 bool XrandrManager::ApplyConfigurationFromFilename (XrandrManager *manager,
                                                     const char    *filename,
                                                     unsigned int   timestamp)
@@ -445,6 +434,54 @@ bool XrandrManager::ApplyConfigurationFromFilename (XrandrManager *manager,
     return  false;
 }
 
+/* 记录当前这组显示器的布局，下次连接同一组显示器时直接恢复 */
+void XrandrManager::RememberCurrentLayout()
+{
+    MateRRConfig *config;
+    QString       fingerprint = LayoutStore::fingerprint (mScreen);
+
+    if (fingerprint.isEmpty())
+        return;
+
+    config = mate_rr_config_new_current (mScreen, NULL);
+    if (!config)
+        return;
+    mLayouts->remember (fingerprint, config);
+    g_object_unref (config);
+}
+
+/**
+ * 按记录恢复当前这组显示器的布局。
+ * 记录的布局已经成功应用过，不再逐项检查，直接一次应用；
+ * 应用失败说明记录已失效，删除后返回 false
+ */
+bool XrandrManager::ApplyRememberedLayout(unsigned int timestamp)
+{
+    MateRRConfig *config;
+    GError       *error = NULL;
+    QString       fingerprint = LayoutStore::fingerprint (mScreen);
+    bool          success = false;
+
+    if (fingerprint.isEmpty())
+        return false;
+
+    config = mate_rr_config_new_current (mScreen, NULL);
+    if (!config)
+        return false;
+
+    if (mLayouts->restore (fingerprint, config)) {
+        success = mate_rr_config_apply_with_time (config, mScreen, timestamp, &error);
+        if (!success) {
+            qWarning("Could not apply remembered layout: %s", error ? error->message : "");
+            if (error)
+                g_error_free (error);
+            mLayouts->forget (fingerprint);
+        }
+    }
+    g_object_unref (config);
+    return success;
+}
+
 void XrandrManager::RestoreBackupConfiguration (XrandrManager  *manager,
                                                 const char     *backup_filename,
                                                 const char     *intended_filename,
@@ -476,26 +513,137 @@ bool XrandrManager::ApplyStoredConfigurationAtStartup(XrandrManager *manager,
     return success;
 }
 
-void SetTouchscreenCursorRotation()
+/**
+ * 重新收集触摸屏设备：每个设备只在这里查询一次设备节点、udev 中的物理尺寸
+ * 和当前的坐标变换矩阵。设备被拔出后很快插回时，设备号和节点通常不变，
+ * 但服务器已把矩阵恢复为单位矩阵，因此不沿用上次写入的矩阵，而是读取实际值
+ */
+void XrandrManager::UpdateTouchDevices()
 {
-    int     event_base, error_base, major, minor;
-    int     o;
-    Window  root;
-    int     xscreen;
-    XRRScreenResources *res;
-    Display *dpy = QX11Info::display();
+    Display          *dpy = gdk_x11_get_default_xdisplay ();
+    QList<TouchDevice> devices;
+    XIDeviceInfo     *devs_info;
+    int               n_devices, i;
 
-    GList *ts_devs = NULL;
+    mTouchDevicesValid = true;
 
-    ts_devs = getTouchscreen (dpy);
+    gdk_x11_display_error_trap_push (gdk_display_get_default ());
+    devs_info = XIQueryDevice(dpy, XIAllDevices, &n_devices);
+    for (i = 0; devs_info && i < n_devices; i++) {
+        TouchDevice  dev;
+        GUdevDevice *udev_device;
 
-    if (!g_list_length (ts_devs))
-    {
-        fprintf(stdin, "No touchscreen find...\n");
+        if (!find_touchscreen_device(dpy, &devs_info[i]))
+            continue;
+
+        dev.id = devs_info[i].deviceid;
+        dev.name = QString::fromLocal8Bit (devs_info[i].name);
+        dev.node = get_device_node (dpy, dev.id);
+        dev.width_mm = dev.height_mm = 0;
+        dev.mapped = false;
+        if (dev.node.isEmpty())
+            continue;
+
+        udev_device = g_udev_client_query_by_device_file (mUdevClient, dev.node.constData());
+        if (udev_device) {
+            if (g_udev_device_has_property (udev_device, "ID_INPUT_WIDTH_MM")) {
+                dev.width_mm = g_udev_device_get_property_as_double (udev_device, "ID_INPUT_WIDTH_MM");
+                dev.height_mm = g_udev_device_get_property_as_double (udev_device, "ID_INPUT_HEIGHT_MM");
+            }
+            g_object_unref (udev_device);
+        }
+
+        dev.mapped = get_device_matrix (dpy, dev.id, dev.matrix);
+        devices.append (dev);
+    }
+    if (devs_info)
+        XIFreeDeviceInfo (devs_info);
+    gdk_x11_display_error_trap_pop_ignored (gdk_display_get_default ());
+
+    mTouchDevices = devices;
+}
+
+/* 触摸屏增减时重新收集设备；X 服务器添加设备略晚于 udev 事件，稍后再映射 */
+void XrandrManager::OnUdevEvent (GUdevClient *client, const gchar *action,
+                                 GUdevDevice *device, gpointer data)
+{
+    XrandrManager *manager = (XrandrManager *) data;
+
+    if (!g_udev_device_get_property_as_boolean (device, "ID_INPUT_TOUCHSCREEN"))
         return;
+    if (g_strcmp0 (action, "add") != 0 && g_strcmp0 (action, "remove") != 0)
+        return;
+
+    manager->mTouchDevicesValid = false;
+    manager->mTouchTimer->start();
+}
+
+/**
+ * 与 xinput --map-to-output 相同的坐标变换矩阵：
+ * 把触摸屏的 [0,1] 坐标映射到输出在整个屏幕中的区域，并按输出旋转
+ */
+static void
+compute_transform_matrix (float m[9], int screen_width, int screen_height,
+                          int x, int y, int width, int height, Rotation rotation)
+{
+    float ox = (float) x / screen_width;
+    float oy = (float) y / screen_height;
+    float w  = (float) width / screen_width;
+    float h  = (float) height / screen_height;
+
+    memset (m, 0, 9 * sizeof (float));
+    m[2] = ox;
+    m[5] = oy;
+    m[8] = 1.0;
+
+    switch (rotation & 0xf) {
+    case RR_Rotate_90:
+        m[1] = -w;
+        m[3] = h;
+        m[2] = ox + w;
+        break;
+    case RR_Rotate_180:
+        m[0] = -w;
+        m[4] = -h;
+        m[2] = ox + w;
+        m[5] = oy + h;
+        break;
+    case RR_Rotate_270:
+        m[1] = w;
+        m[3] = -h;
+        m[5] = oy + h;
+        break;
+    default:
+        m[0] = w;
+        m[4] = h;
+        break;
     }
+}
 
-    GList *l = NULL;
+/**
+ * 把触摸屏映射到物理尺寸相符的输出。
+ * 矩阵在进程内计算，直接写入设备的 "Coordinate Transformation Matrix" 属性；
+ * 只有输出的位置、大小或旋转改变，使矩阵与上次写入的不同时才写入
+ */
+void XrandrManager::SetTouchscreenCursorRotation()
+{
+    int     event_base, error_base, major, minor;
+    int     o;
+    Window  root;
+    XRRScreenResources *res;
+    Display *dpy = gdk_x11_get_default_xdisplay ();
+    Atom    prop_matrix, prop_float;
+    Window  root_ret;
+    int     rx, ry;
+    unsigned int screen_width, screen_height, border, depth;
+    QSet<int> done;
+
+    if (!mUdevClient)
+        return;
+    if (!mTouchDevicesValid)
+        UpdateTouchDevices();
+    if (mTouchDevices.isEmpty())
+        return;
 
     if (!XRRQueryExtension (dpy, &event_base, &error_base) ||
         !XRRQueryVersion (dpy, &major, &minor))
@@ -503,65 +651,74 @@ void SetTouchscreenCursorRotation()
         fprintf (stderr, "RandR extension missing\n");
         return;
     }
+    if (major < 1 || (major == 1 && minor < 5)) {
+        fprintf(stderr, "xrandr extension too low\n");
+        return;
+    }
+
+    prop_matrix = XInternAtom (dpy, "Coordinate Transformation Matrix", True);
+    prop_float = XInternAtom (dpy, "FLOAT", True);
+    if (!prop_matrix || !prop_float)
+        return;
 
-    xscreen = DefaultScreen (dpy);
-    root = RootWindow (dpy, xscreen);
+    root = RootWindow (dpy, DefaultScreen (dpy));
+    if (!XGetGeometry (dpy, root, &root_ret, &rx, &ry, &screen_width, &screen_height, &border, &depth))
+        return;
 
-    if ( major >= 1 && minor >= 5)
+    /* 使用服务器当前的资源，不触发输出探测 */
+    res = XRRGetScreenResourcesCurrent (dpy, root);
+    if (!res)
+        return;
+
+    gdk_x11_display_error_trap_push (gdk_display_get_default ());
+    for (o = 0; o < res->noutput; o++)
     {
-        res = XRRGetScreenResources (dpy, root);
-        if (!res)
-          return;
+        XRROutputInfo *output_info = XRRGetOutputInfo (dpy, res, res->outputs[o]);
+        XRRCrtcInfo   *crtc_info;
 
-        for (o = 0; o < res->noutput; o++)
-        {
-            XRROutputInfo *output_info = XRRGetOutputInfo (dpy, res, res->outputs[o]);
+        if (!output_info)
+            continue;
+        if (output_info->connection != RR_Connected || !output_info->crtc) {
+            XRRFreeOutputInfo (output_info);
+            continue;
+        }
+        crtc_info = XRRGetCrtcInfo (dpy, res, output_info->crtc);
+        if (!crtc_info) {
+            XRRFreeOutputInfo (output_info);
+            continue;
+        }
+
+        for (int i = 0; i < mTouchDevices.size(); i++) {
+            TouchDevice &dev = mTouchDevices[i];
+            float        matrix[9];
 
-            if (!output_info)
-            {
-                fprintf (stderr, "could not get output 0x%lx information\n", res->outputs[o]);
+            if (done.contains (dev.id) || dev.width_mm <= 0 || dev.height_mm <= 0)
+                continue;
+            if (!checkMatch (output_info->mm_width, output_info->mm_height, dev.width_mm, dev.height_mm))
                 continue;
-            }
 
-            if (output_info->connection == 0)
-            {
-                int output_mm_width = output_info->mm_width;
-                int output_mm_height = output_info->mm_height;
-
-                for ( l = ts_devs; l; l = l->next)
-                {
-                    TsInfo *info = (TsInfo *)l -> data;
-                    GUdevDevice *udev_device;
-                    const char *udev_subsystems[] = {"input", NULL};
-
-                    double width, height;
-
-                    GUdevClient *udev_client = g_udev_client_new (udev_subsystems);
-                    udev_device = g_udev_client_query_by_device_file (udev_client, (const gchar *)info->input_node);
-
-                    if (udev_device &&
-                        g_udev_device_has_property (udev_device, "ID_INPUT_WIDTH_MM"))
-                    {
-                        width = g_udev_device_get_property_as_double (udev_device,
-                                                                    "ID_INPUT_WIDTH_MM");
-                        height = g_udev_device_get_property_as_double (udev_device,
-                                                                     "ID_INPUT_HEIGHT_MM");
-
-                        if (checkMatch(output_mm_width, output_mm_height, width, height))
-                        {
-                            doAction(info->dev_info.name, output_info->name);
-                        }
-                    }
-                    g_clear_object (&udev_client);
-                }
-            }
+            done.insert (dev.id);
+            compute_transform_matrix (matrix, screen_width, screen_height,
+                                      crtc_info->x, crtc_info->y,
+                                      crtc_info->width, crtc_info->height,
+                                      crtc_info->rotation);
+            if (dev.mapped && memcmp (matrix, dev.matrix, sizeof (matrix)) == 0)
+                continue;
+
+            qDebug("map touchscreen \"%s\" to output %s", dev.name.toLocal8Bit().data(), output_info->name);
+            XIChangeProperty (dpy, dev.id, prop_matrix, prop_float, 32,
+                              XIPropModeReplace, (unsigned char *) matrix, 9);
+            memcpy (dev.matrix, matrix, sizeof (matrix));
+            dev.mapped = true;
         }
-    }else {
-        g_list_free(ts_devs);
-        fprintf(stderr, "xrandr extension too low\n");
-        return;
+        XRRFreeCrtcInfo (crtc_info);
+        XRRFreeOutputInfo (output_info);
+    }
+    XRRFreeScreenResources (res);
+    if (gdk_x11_display_error_trap_pop (gdk_display_get_default ())) {
+        /* 设备可能刚被移除，下次重新收集 */
+        mTouchDevicesValid = false;
     }
-    g_list_free(ts_devs);
 }
 
 void XrandrManager::oneScaleLogoutDialog(QGSettings *settings)
@@ -581,8 +738,9 @@ void XrandrManager::oneScaleLogoutDialog(QGSettings *settings)
 
     switch (ret) {
         case QMessageBox::Yes:
-            QGSettings *mouseSettings = new QGSettings("org.ukui.peripherals-mouse");
+            QGSettings *mouseSettings = SettingsPool::ref("org.ukui.peripherals-mouse");
             mouseSettings->set("cursor-size", 24);
+            SettingsPool::unref(mouseSettings);
             settings->set(XSETTINGS_KEY_SCALING, 1);
             QProcess::execute("ukui-session-tools --logout");
         break;
@@ -605,8 +763,9 @@ void XrandrManager::twoScaleLogoutDialog(QGSettings *settings)
     int ret = box->exec();
     switch (ret) {
         case QMessageBox::Yes:
-            QGSettings *mouseSettings = new QGSettings("org.ukui.peripherals-mouse");
+            QGSettings *mouseSettings = SettingsPool::ref("org.ukui.peripherals-mouse");
             mouseSettings->set("cursor-size", 48);
+            SettingsPool::unref(mouseSettings);
             settings->set(XSETTINGS_KEY_SCALING, 2);
             QProcess::execute("ukui-session-tools --logout");
         break;
@@ -692,13 +851,24 @@ void XrandrManager::monitorSettingsScreenScale(MateRRScreen *screen)
 }
 /**
  * @brief XrandrManager::OnRandrEvent : 屏幕事件回调函数
+ * 一次插拔会产生多个事件，交给 DisplayCoordinator 合并后执行 LayoutStage
  * @param screen
  * @param data
  */
 void XrandrManager::OnRandrEvent(MateRRScreen *screen, gpointer data)
+{
+    DisplayCoordinator::queueChange();
+}
+
+/**
+ * @brief XrandrManager::LayoutStage : 显示配置变化后的布局阶段
+ * 应用了新的布局时返回 true，其余阶段等新配置生效后再执行
+ */
+bool XrandrManager::LayoutStage(gpointer data)
 {
     unsigned int change_timestamp, config_timestamp;
     XrandrManager *manager = (XrandrManager*) data;
+    MateRRScreen  *screen = manager->mScreen;
 
     /* 获取更改时间 和 配置时间 */
     mate_rr_screen_get_timestamps (screen, &change_timestamp, &config_timestamp);
@@ -710,37 +880,125 @@ void XrandrManager::OnRandrEvent(MateRRScreen *screen, gpointer data)
          * to do anything, either; the screen is already configured.
          */
         qDebug()<<"Ignoring event since change >= config";
+        /* 记下这次配置，作为这组显示器的布局 */
+        manager->RememberCurrentLayout();
     } else {
         char *intended_filename;
         bool  success;
-        intended_filename = mate_rr_config_get_intended_filename ();
-        success = ApplyConfigurationFromFilename (manager, intended_filename, config_timestamp);
-        free (intended_filename);
+
+        /* 连接过的一组显示器直接恢复上次的布局 */
+        success = manager->ApplyRememberedLayout (config_timestamp);
+        if (!success) {
+            intended_filename = mate_rr_config_get_intended_filename ();
+            success = ApplyConfigurationFromFilename (manager, intended_filename, config_timestamp);
+            free (intended_filename);
+        }
         if(!success)
-            manager->AutoConfigureOutputs (manager, config_timestamp);
+            success = manager->AutoConfigureOutputs (manager, config_timestamp);
         monitorSettingsScreenScale (screen);
+        if (success)
+            return true;
     }
     /* 添加触摸屏鼠标设置 */
-    SetTouchscreenCursorRotation();
+    manager->SetTouchscreenCursorRotation();
+    return false;
+}
+
+#define ROTATION_MASK   (MATE_RR_ROTATION_0 | MATE_RR_ROTATION_90 | \
+                         MATE_RR_ROTATION_180 | MATE_RR_ROTATION_270)
+
+static bool
+rotation_is_portrait (MateRRRotation rotation)
+{
+    return (rotation & (MATE_RR_ROTATION_90 | MATE_RR_ROTATION_270)) != 0;
+}
+
+static gint
+compare_output_x (gconstpointer a, gconstpointer b)
+{
+    int xa, xb;
+
+    mate_rr_output_info_get_geometry ((MateRROutputInfo *) a, &xa, NULL, NULL, NULL);
+    mate_rr_output_info_get_geometry ((MateRROutputInfo *) b, &xb, NULL, NULL, NULL);
+    return xa - xb;
+}
+
+/**
+ * 在配置中把所有已打开的输出设为 rotation，保留各自的镜像标志。
+ * 横竖方向改变后输出的逻辑宽度随之改变，非镜像布局时按原来的
+ * 左右顺序重新排列，避免旋转后的输出互相重叠。
+ * 返回 false 表示配置没有变化
+ */
+static bool
+rotate_config_outputs (MateRRConfig *config, MateRRRotation rotation)
+{
+    MateRROutputInfo **outputs = mate_rr_config_get_outputs (config);
+    GList   *active = NULL, *l;
+    bool     changed = false;
+    bool     clone = true;
+    int      first_x = 0, first_y = 0;
+    int      i, x;
+
+    for (i = 0; outputs[i] != NULL; i++) {
+        MateRROutputInfo *info = outputs[i];
+        MateRRRotation    old_rotation;
+        int               ox, oy;
+
+        if (!mate_rr_output_info_is_connected (info) || !mate_rr_output_info_is_active (info))
+            continue;
+
+        old_rotation = mate_rr_output_info_get_rotation (info);
+        if ((old_rotation & ROTATION_MASK) != rotation) {
+            mate_rr_output_info_set_rotation (info, (MateRRRotation) ((old_rotation & ~ROTATION_MASK) | rotation));
+            changed = true;
+        }
+
+        mate_rr_output_info_get_geometry (info, &ox, &oy, NULL, NULL);
+        if (active == NULL) {
+            first_x = ox;
+            first_y = oy;
+        } else if (ox != first_x || oy != first_y) {
+            clone = false;
+        }
+        active = g_list_prepend (active, info);
+    }
+
+    /* 输出的宽高是模式本身的尺寸，排列时按旋转后的逻辑宽度计算 */
+    if (changed && !clone) {
+        active = g_list_sort (active, compare_output_x);
+        x = 0;
+        for (l = active; l; l = l->next) {
+            MateRROutputInfo *info = (MateRROutputInfo *) l->data;
+            int oy, width, height;
+
+            mate_rr_output_info_get_geometry (info, NULL, &oy, &width, &height);
+            mate_rr_output_info_set_geometry (info, x, oy, width, height);
+            x += rotation_is_portrait (mate_rr_output_info_get_rotation (info)) ? height : width;
+        }
+    }
+    g_list_free (active);
+
+    return changed;
 }
 
-/*监听旋转键值回调 并设置旋转角度*/
+/**
+ * 监听旋转键值回调 并设置旋转角度
+ * 所有输出的旋转在一个 MateRRConfig 中一次应用：帧缓冲大小由配置预先算出，
+ * 整个修改在服务器抓取下完成，只发生一次模式设置
+ */
 void XrandrManager::RotationChangedEvent(QString key)
 {
-    int angle, i;
-    MateRRConfig        *result;
-    MateRROutputInfo    **outputs;
+    int angle;
+    MateRRConfig        *config;
     MateRRRotation      rotation;
-    unsigned int config_timestamp;
+    GError              *error = NULL;
+
     if(key != XRANDR_ROTATION_KEY)
         return;
 
     angle = mXrandrSetting->getEnum(XRANDR_ROTATION_KEY);
     qDebug()<<"angle = "<<angle;
-    /*switch (angle) {
-        case 0:
-            rotation = MATE_RR_ROTATION_0;
-        break;
+    switch (angle) {
         case 1:
             rotation = MATE_RR_ROTATION_90;
         break;
@@ -750,34 +1008,26 @@ void XrandrManager::RotationChangedEvent(QString key)
         case 3:
             rotation = MATE_RR_ROTATION_270;
         break;
-    }*/
-    //mate_rr_screen_get_timestamps (mScreen, nullptr, &config_timestamp);
-    result = mate_rr_config_new_current (mScreen, NULL);
-    outputs = mate_rr_config_get_outputs (result);
-    for (i = 0; outputs[i] != NULL; ++i) {
-        MateRROutputInfo *info = outputs[i];
-        if (mate_rr_output_info_is_connected (info)) {
-            QString name = mate_rr_output_info_get_name(info);
-            qDebug()<<"name = " << name;
-            switch(angle) {
-                case 0:
-                    QProcess::execute("xrandr --output "+ name + " --rotate normal");
-                break;
-                case 1:
-                    QProcess::execute("xrandr --output "+ name + " --rotate left");
-                break;
-                case 2:
-                    QProcess::execute("xrandr --output "+ name + " --rotate inverted");
-                break;
-                case 3:
-                    QProcess::execute("xrandr --output "+ name + " --rotate right");
-                break;
-            }
-            //mate_rr_output_info_set_rotation (info, rotation);
+        default:
+            rotation = MATE_RR_ROTATION_0;
+        break;
+    }
+
+    config = mate_rr_config_new_current (mScreen, &error);
+    if (config == NULL) {
+        qWarning("Could not get current configuration: %s", error ? error->message : "");
+        g_clear_error (&error);
+        return;
+    }
+
+    if (rotate_config_outputs (config, rotation)) {
+        if (!mate_rr_config_applicable (config, mScreen, &error) ||
+            !mate_rr_config_apply_with_time (config, mScreen, GDK_CURRENT_TIME, &error)) {
+            qWarning("Could not rotate outputs: %s", error ? error->message : "");
+            g_clear_error (&error);
         }
     }
-    //mate_rr_config_apply_with_time (result, mScreen, config_timestamp, NULL);
-    g_object_unref (result);
+    g_object_unref (config);
 }
 
 /**
@@ -799,9 +1049,14 @@ void XrandrManager::StartXrandrIdleCb()
         return;
     }
     g_signal_connect (mScreen, "changed", G_CALLBACK (OnRandrEvent), this);
+    DisplayCoordinator::addStage (DISPLAY_STAGE_LAYOUT, LayoutStage, this);
 
     connect(mXrandrSetting,SIGNAL(changed(QString)),this,SLOT(RotationChangedEvent(QString)));
 
+    const char *udev_subsystems[] = {"input", NULL};
+    mUdevClient = g_udev_client_new (udev_subsystems);
+    g_signal_connect (mUdevClient, "uevent", G_CALLBACK (OnUdevEvent), this);
+
     /*设置虚拟机分辨率*/
     ScreenNum  = QApplication::screens().length();
     ScreenName = QApplication::primaryScreen()->name();
@@ -48,6 +48,20 @@ extern "C" {
 #include <libmate-desktop/mate-desktop-utils.h>
 }
 
+#include "layout-solver.h"
+#include "layout-store.h"
+
+/* 触摸屏设备及其物理尺寸，设备增减时由 udev 事件触发重新收集 */
+typedef struct {
+    int         id;             /* XI2 设备号 */
+    QString     name;
+    QByteArray  node;           /* 如 /dev/input/event6 */
+    double      width_mm;
+    double      height_mm;
+    bool        mapped;         /* matrix 与设备上的矩阵一致 */
+    float       matrix[9];      /* 设备当前的坐标变换矩阵 */
+} TouchDevice;
+
 class XrandrManager: public QObject
 {
     Q_OBJECT
@@ -64,6 +78,7 @@ public:
 public Q_SLOTS:
     void StartXrandrIdleCb ();
     void RotationChangedEvent(QString);
+    void SetTouchscreenCursorRotation();
 
 public:
     bool ReadMonitorsXml();
@@ -73,7 +88,8 @@ public:
                                     const char    *intended_filename,
                                     unsigned int   timestamp);
     static void OnRandrEvent (MateRRScreen *screen, gpointer data);
-    static void AutoConfigureOutputs (XrandrManager *manager,
+    static bool LayoutStage (gpointer data);
+    static bool AutoConfigureOutputs (XrandrManager *manager,
                                       unsigned int  timestamp);
     static bool ApplyConfigurationFromFilename   (XrandrManager *manager,
                                                   const char    *filename,
@@ -83,12 +99,22 @@ public:
     static void monitorSettingsScreenScale (MateRRScreen *screen);
     static void oneScaleLogoutDialog(QGSettings *settings);
     static void twoScaleLogoutDialog(QGSettings *settings);
+    static void OnUdevEvent (GUdevClient *client, const gchar *action,
+                             GUdevDevice *device, gpointer data);
+    void UpdateTouchDevices();
+    void RememberCurrentLayout();
+    bool ApplyRememberedLayout(unsigned int timestamp);
 
 private:
     QTimer                *time;
     QGSettings            *mXrandrSetting;
     static XrandrManager  *mXrandrManager;
     MateRRScreen          *mScreen;
+    GUdevClient           *mUdevClient;
+    QList<TouchDevice>     mTouchDevices;
+    bool                   mTouchDevicesValid;
+    QTimer                *mTouchTimer;     /* 等待 X 服务器添加 udev 报告的新设备 */
+    LayoutStore           *mLayouts;
 
 protected:
     QMultiMap<QString, QString> XmlFileTag; //存放标签的属性值
@@ -26,10 +26,14 @@ PKGCONFIG += \
             gudev-1.0
 
 SOURCES += \
+    layout-solver.cpp \
+    layout-store.cpp \
     xrandr-manager.cpp \
     xrandr-plugin.cpp
 
 HEADERS += \
+    layout-solver.h \
+    layout-store.h \
     xrandr-manager.h \
     xrandr-plugin.h
 
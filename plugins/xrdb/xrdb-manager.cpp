@@ -25,6 +25,7 @@
 #include <QDBusConnection>
 #include <QDebug>
 #include "xrdb-manager.h"
+#include "ukui-settings-pool.h"
 #include <syslog.h>
 
 #define midColor(x,low,high) (((x) > (high)) ? (high): (((x) < (low)) ? (low) : (x)))
@@ -54,7 +55,7 @@ bool ukuiXrdbManager::start(GError **error)
 {
     syslog(LOG_DEBUG,"Starting xrdb manager!");
 
-    settings = new QGSettings(SCHEMAS);
+    settings = SettingsPool::ref(SCHEMAS);
     allUsefulAdFiles = new QList<QString>();
     widget = gtk_window_new (GTK_WINDOW_TOPLEVEL);
     //gtk_widget_realize (widget);
@@ -64,7 +65,7 @@ bool ukuiXrdbManager::start(GError **error)
        false hit as gtk-theme-name is set to Default in
        ukui_settings_xsettings_init */
     if(nullptr != settings)
-        connect(settings,SIGNAL(changed(const QString&)),this,SLOT(themeChanged(const QString&)));
+        connect(settings,SIGNAL(changedBatch(const QStringList&)),this,SLOT(themeChanged(const QStringList&)));
 
     return true;
 }
@@ -72,8 +73,12 @@ bool ukuiXrdbManager::start(GError **error)
 void ukuiXrdbManager::stop()
 {
     syslog(LOG_DEBUG,"Stopping xrdb manager!");
-    if(settings)
-        delete settings;
+    if(settings) {
+        /* 共享对象在其他插件中仍然存活，需要断开连接 */
+        disconnect(settings, nullptr, this, nullptr);
+        SettingsPool::unref(settings);
+        settings = nullptr;
+    }
     if(allUsefulAdFiles){
         allUsefulAdFiles->clear();
         delete allUsefulAdFiles;
@@ -385,13 +390,13 @@ void ukuiXrdbManager::applySettings(){
 }
 
 /** func : private slots for gsettings key 'gtk-theme' changed
- *         监听 'gtk-theme' key值变化的槽函数
+ *         监听 'gtk-theme' key值变化的槽函数, 一批 key 改变只重新应用一次
  */
-void ukuiXrdbManager::themeChanged (const QString& key)
+void ukuiXrdbManager::themeChanged (const QStringList& keyList)
 {
     /* 监听主题更改，发送dbus信号 */
-    if(key.compare("gtk-theme")==0){
-        QString keys = settings->get(key).toString();
+    if(keyList.contains("gtk-theme")){
+        QString keys = settings->get("gtk-theme").toString();
         if (keys.compare("ukui-white")==0){
             QDBusMessage message = 
 		    QDBusMessage::createSignal("/KGlobalSettings",
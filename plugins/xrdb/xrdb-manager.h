@@ -73,7 +73,7 @@ private:
     void appendColor(QString name,GdkColor* color);
     void colorShade(QString name,GdkColor* color,double shade);
 private Q_SLOTS:
-    void themeChanged (const QString& key);
+    void themeChanged (const QStringList& keyList);
 
 private:
     static ukuiXrdbManager* mXrdbManager;
@@ -22,6 +22,8 @@
 #include "fontconfig-monitor.h"
 #include "ukui-xft-settings.h"
 #include "xsettings-const.h"
+#include "ukui-settings-pool.h"
+#include "ukui-display-coordinator.h"
 
 #include <gtk/gtk.h>
 #include <gdk/gdkx.h>
@@ -46,6 +48,9 @@
 #define DPI_LOW_REASONABLE_VALUE 50
 #define DPI_HIGH_REASONABLE_VALUE 500
 
+/* 合并短时间内多个 key 的改变，只重新计算/通知一次(毫秒) */
+#define NOTIFY_QUIET_PERIOD 50
+
 typedef struct _TranslationEntry TranslationEntry;
 typedef void (* TranslationFunc) (ukuiXSettingsManager  *manager,
                                   TranslationEntry      *trans,
@@ -75,6 +80,7 @@ enum {
 
 static void     fontconfig_callback (fontconfig_monitor_handle_t *handle,
                                      ukuiXSettingsManager       *manager);
+static void     queue_notify        (ukuiXSettingsManager       *manager);
 static void
 xft_callback (GSettings            *gsettings,
               const gchar          *key,
@@ -230,6 +236,8 @@ ukuiXSettingsManager::ukuiXSettingsManager()
     gsettings=nullptr;
     gsettings_font=nullptr;
     fontconfig_handle=nullptr;
+    notify_id=0;
+    xft_pending=FALSE;
 }
 
 ukuiXSettingsManager::~ukuiXSettingsManager()
@@ -289,9 +297,7 @@ xsettings_callback (GSettings             *gsettings,
                                             "ukui");
     }
 
-    for (i = 0; manager->pManagers [i]; i++) {
-        manager->pManagers [i]->notify ();
-    }
+    queue_notify (manager);
 }
 
 
@@ -339,20 +345,63 @@ void update_xft_settings (ukuiXSettingsManager *manager)
     settings.xft_settings_set_xresources ();
 }
 
-static void
-xft_callback (GSettings            *gsettings,
-              const gchar          *key,
-              ukuiXSettingsManager *manager)
+static gboolean
+notify_timeout_cb (ukuiXSettingsManager *manager)
 {
     int i;
 
-    update_xft_settings (manager);
+    manager->notify_id = 0;
+    if (manager->xft_pending) {
+        manager->xft_pending = FALSE;
+        update_xft_settings (manager);
+    }
     for (i = 0; manager->pManagers [i]; i++) {
         manager->pManagers [i]->notify ();
     }
+    return G_SOURCE_REMOVE;
+}
+
+/* 一批 key 改变(例如恢复默认设置)只发送一次 XSETTINGS 通知 */
+static void
+queue_notify (ukuiXSettingsManager *manager)
+{
+    if (manager->notify_id == 0)
+        manager->notify_id = g_timeout_add (NOTIFY_QUIET_PERIOD,
+                                            (GSourceFunc) notify_timeout_cb,
+                                            manager);
+}
+
+static void
+xft_callback (GSettings            *gsettings,
+              const gchar          *key,
+              ukuiXSettingsManager *manager)
+{
+    manager->xft_pending = TRUE;
+    queue_notify (manager);
+}
+
+
+/* 显示器改变后由 DisplayCoordinator 在布局确定后调用一次 */
+static void
+screen_changed_callback (GdkScreen *screen, ukuiXSettingsManager *manager)
+{
+    DisplayCoordinator::queueChange ();
 }
 
+/* 自动缩放和 DPI 取决于主显示器，显示配置改变后重新计算并立即通知 */
+static bool
+display_changed_stage (gpointer data)
+{
+    ukuiXSettingsManager *manager = (ukuiXSettingsManager *) data;
 
+    if (manager->notify_id != 0) {
+        g_source_remove (manager->notify_id);
+        manager->notify_id = 0;
+    }
+    manager->xft_pending = TRUE;
+    notify_timeout_cb (manager);
+    return false;
+}
 
 static void
 fontconfig_callback (fontconfig_monitor_handle_t *handle,
@@ -382,9 +431,9 @@ bool ukuiXSettingsManager::start()
     gsettings = g_hash_table_new_full (g_str_hash, g_str_equal,
                                        NULL, (GDestroyNotify) g_object_unref);
     g_hash_table_insert ( gsettings,(void*)MOUSE_SCHEMA,
-                          g_settings_new (MOUSE_SCHEMA));
+                          SettingsPool::gsettingsRef (MOUSE_SCHEMA));
     g_hash_table_insert ( gsettings,(void*)INTERFACE_SCHEMA,
-                          g_settings_new (INTERFACE_SCHEMA));
+                          SettingsPool::gsettingsRef (INTERFACE_SCHEMA));
     g_hash_table_insert ( gsettings,(void*)SOUND_SCHEMA,
                           g_settings_new (SOUND_SCHEMA));
     g_hash_table_insert (gsettings,(void*)XSETTINGS_PLUGIN_SCHEMA,
@@ -415,6 +464,12 @@ bool ukuiXSettingsManager::start()
 
     update_xft_settings (this);
     start_fontconfig_monitor (this);
+
+    g_signal_connect (gdk_screen_get_default (), "monitors-changed",
+                      G_CALLBACK (screen_changed_callback), this);
+    g_signal_connect (gdk_screen_get_default (), "size-changed",
+                      G_CALLBACK (screen_changed_callback), this);
+    DisplayCoordinator::addStage (DISPLAY_STAGE_XSETTINGS, display_changed_stage, this);
     for (i = 0;  pManagers [i]; i++){
         pManagers [i]->set_string ( "Net/FallbackIconTheme", "ukui");
     }
@@ -427,6 +482,14 @@ bool ukuiXSettingsManager::start()
 int ukuiXSettingsManager::stop()
 {
     int i;
+
+    g_signal_handlers_disconnect_by_func (gdk_screen_get_default (),
+                                          (gpointer) screen_changed_callback, this);
+    DisplayCoordinator::removeStage (DISPLAY_STAGE_XSETTINGS, display_changed_stage, this);
+    if (notify_id != 0) {
+        g_source_remove (notify_id);
+        notify_id = 0;
+    }
     if (pManagers != NULL) {
         for (i = 0; pManagers [i]; ++i) {
             delete (pManagers[i]);
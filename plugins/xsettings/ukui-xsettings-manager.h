@@ -46,6 +46,8 @@ public:
     GSettings   *gsettings_font;
     //GSettings   *plugin_settings;
     fontconfig_monitor_handle_t *fontconfig_handle;
+    guint        notify_id;     /* 合并通知的定时器 */
+    gboolean     xft_pending;   /* 定时器触发时需要重新计算 xft 设置 */
 };
 
 #endif // UKUIXSETTINGSMANAGER_H
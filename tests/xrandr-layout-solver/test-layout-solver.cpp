@@ -0,0 +1,197 @@
+/* -*- Mode: C++; indent-tabs-mode: nil; tab-width: 4 -*-
+ * -*- coding: utf-8 -*-
+ *
+ * Copyright (C) 2020 KylinSoft Co., Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <QtTest>
+
+#include "layout-solver.h"
+
+/* 以下屏幕描述按真实插拔时的输出、模式和 CRTC 整理 */
+
+static SolverMode
+make_mode (int width, int height, int rate)
+{
+    SolverMode mode;
+
+    mode.width = width;
+    mode.height = height;
+    mode.rate = rate;
+    return mode;
+}
+
+static SolverOutput
+make_output (const QString &name, const QList<int> &crtcs)
+{
+    SolverOutput output;
+
+    output.name = name;
+    output.connected = true;
+    output.possibleCrtcs = crtcs;
+    output.modes << make_mode (1920, 1080, 60) << make_mode (1280, 1024, 60)
+                 << make_mode (1024, 768, 60);
+    output.preferred = 0;
+    return output;
+}
+
+/* 已打开的输出：当前使用 modes[0]，占用 crtc */
+static SolverOutput
+make_kept_output (const QString &name, int crtc, int x, int y)
+{
+    SolverOutput output = make_output (name, QList<int> () << crtc);
+
+    output.active = true;
+    output.crtc = crtc;
+    output.x = x;
+    output.y = y;
+    output.width = output.modes[0].width;
+    output.height = output.modes[0].height;
+    output.rate = output.modes[0].rate;
+    return output;
+}
+
+class TestLayoutSolver : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void preferredModeTooWide();
+    void reassignCrtcs();
+    void clonedKeptOutputs();
+    void portraitKeptOutput();
+    void turnOffNewest();
+};
+
+/* 首选模式超出帧缓冲区宽度时换用放得下的最大模式 */
+void TestLayoutSolver::preferredModeTooWide()
+{
+    SolverScreen screen;
+
+    screen.maxWidth = 3200;
+    screen.maxHeight = 2048;
+    screen.outputs << make_kept_output ("eDP-1", 1, 0, 0)
+                   << make_output ("HDMI-1", QList<int> () << 2);
+
+    QVERIFY(LayoutSolver::solve (screen));
+
+    const SolverOutput &added = screen.outputs[1];
+    QVERIFY(added.active);
+    QVERIFY(added.turnedOn);
+    QCOMPARE(added.x, 1920);
+    QCOMPARE(added.width, 1280);
+    QCOMPARE(added.height, 1024);
+}
+
+/**
+ * CRTC 少于输出：先到的输出需要让出唯一能驱动后者的 CRTC 才能都打开，
+ * 多出的输出保持关闭
+ */
+void TestLayoutSolver::reassignCrtcs()
+{
+    SolverScreen screen;
+
+    screen.maxWidth = 8192;
+    screen.maxHeight = 8192;
+    screen.outputs << make_output ("DP-1", QList<int> () << 1 << 2)
+                   << make_output ("DP-2", QList<int> () << 1)
+                   << make_output ("DP-3", QList<int> () << 1 << 2);
+
+    QVERIFY(LayoutSolver::solve (screen));
+
+    QVERIFY(screen.outputs[0].active);
+    QCOMPARE(screen.outputs[0].x, 0);
+
+    QVERIFY(screen.outputs[1].active);
+    QCOMPARE(screen.outputs[1].x, 1920);
+
+    QVERIFY(!screen.outputs[2].active);
+    QVERIFY(!screen.outputs[2].turnedOn);
+}
+
+/* 镜像的已打开输出保持原位，新输出放在镜像区域右侧 */
+void TestLayoutSolver::clonedKeptOutputs()
+{
+    SolverScreen screen;
+
+    screen.maxWidth = 8192;
+    screen.maxHeight = 8192;
+    screen.outputs << make_kept_output ("eDP-1", 1, 100, 50)
+                   << make_kept_output ("HDMI-1", 2, 100, 50)
+                   << make_output ("DP-1", QList<int> () << 3);
+
+    QVERIFY(LayoutSolver::solve (screen));
+
+    QCOMPARE(screen.outputs[0].x, 100);
+    QCOMPARE(screen.outputs[0].y, 50);
+    QCOMPARE(screen.outputs[1].x, 100);
+    QCOMPARE(screen.outputs[1].y, 50);
+    QVERIFY(!screen.outputs[0].turnedOn);
+
+    QVERIFY(screen.outputs[2].active);
+    QCOMPARE(screen.outputs[2].x, 100 + 1920);
+    QCOMPARE(screen.outputs[2].y, 0);
+}
+
+/* 竖屏的已打开输出按旋转后的宽度（模式的高）占位 */
+void TestLayoutSolver::portraitKeptOutput()
+{
+    SolverScreen screen;
+
+    screen.maxWidth = 8192;
+    screen.maxHeight = 8192;
+    screen.outputs << make_kept_output ("DP-1", 1, 300, 0)
+                   << make_output ("DP-2", QList<int> () << 2);
+    screen.outputs[0].portrait = true;
+
+    QVERIFY(LayoutSolver::solve (screen));
+
+    QCOMPARE(screen.outputs[0].x, 0);
+    QCOMPARE(screen.outputs[0].width, 1920);
+    QCOMPARE(screen.outputs[0].height, 1080);
+    QVERIFY(screen.outputs[0].portrait);
+
+    QVERIFY(screen.outputs[1].active);
+    QCOMPARE(screen.outputs[1].x, 1080);
+}
+
+/* 应用失败时从最右侧的新输出开始关闭，已打开的输出不受影响 */
+void TestLayoutSolver::turnOffNewest()
+{
+    SolverScreen screen;
+
+    screen.maxWidth = 8192;
+    screen.maxHeight = 8192;
+    screen.outputs << make_kept_output ("eDP-1", 1, 0, 0)
+                   << make_output ("DP-1", QList<int> () << 2)
+                   << make_output ("DP-2", QList<int> () << 3);
+
+    QVERIFY(LayoutSolver::solve (screen));
+
+    QVERIFY(LayoutSolver::turnOffNewest (screen));
+    QVERIFY(screen.outputs[1].active);
+    QVERIFY(!screen.outputs[2].active);
+
+    QVERIFY(LayoutSolver::turnOffNewest (screen));
+    QVERIFY(!screen.outputs[1].active);
+    QVERIFY(screen.outputs[0].active);
+
+    QVERIFY(!LayoutSolver::turnOffNewest (screen));
+    QVERIFY(screen.outputs[0].active);
+}
+
+QTEST_APPLESS_MAIN(TestLayoutSolver)
+
+#include "test-layout-solver.moc"
@@ -0,0 +1,23 @@
+#-------------------------------------------------
+#
+# xrandr 插件自动布局求解的单元测试
+#
+#-------------------------------------------------
+QT       += testlib
+QT       -= gui
+
+TARGET = test-layout-solver
+TEMPLATE = app
+
+CONFIG += c++11 no_keywords console testcase
+CONFIG -= app_bundle
+
+INCLUDEPATH += \
+        $$PWD/../../plugins/xrandr
+
+SOURCES += \
+        $$PWD/test-layout-solver.cpp \
+        $$PWD/../../plugins/xrandr/layout-solver.cpp
+
+HEADERS += \
+        $$PWD/../../plugins/xrandr/layout-solver.h
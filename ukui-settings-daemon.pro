@@ -28,7 +28,8 @@ SUBDIRS += \
     $$PWD/plugins/xrdb/xrdb.pro                 \
     $$PWD/plugins/xsettings/xsettings.pro       \
     $$PWD/plugins/locate-pointer/usd-locate-pointer.pro \
-    $$PWD/daemon/daemon.pro
+    $$PWD/daemon/daemon.pro                     \
+    $$PWD/tests/xrandr-layout-solver/xrandr-layout-solver.pro
 
 include($$PWD/data/data.pri)
 